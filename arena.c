@@ -0,0 +1,89 @@
+#include "arena.h"
+
+#include <string.h>
+
+#include "memory.h"
+
+struct ArenaBlock {
+  ArenaBlock* next;
+  size_t size;
+  size_t used;
+  // keeps data aligned to ARENA_ALIGNMENT
+  size_t padding;
+  char data[];
+};
+
+static inline size_t alignSize(size_t size) {
+  return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+void initArena(Arena* arena) {
+  arena->blocks = NULL;
+  arena->bytesAllocated = 0;
+}
+
+static ArenaBlock* newBlock(Arena* arena, size_t minSize) {
+  // blocks double so that a growing array needs few of them
+  size_t size = arena->blocks == NULL ? ARENA_MIN_BLOCK_SIZE
+                                      : arena->blocks->size * 2;
+  while (size < minSize) size *= 2;
+
+  // blocks come from reallocate, so they count towards the GC threshold
+  ArenaBlock* block =
+      (ArenaBlock*)reallocate(NULL, 0, sizeof(ArenaBlock) + size);
+  block->next = arena->blocks;
+  block->size = size;
+  block->used = 0;
+  arena->blocks = block;
+  arena->bytesAllocated += sizeof(ArenaBlock) + size;
+  return block;
+}
+
+void* arenaAllocate(Arena* arena, size_t size) {
+  size = alignSize(size);
+
+  ArenaBlock* block = arena->blocks;
+  if (block == NULL || block->size - block->used < size) {
+    block = newBlock(arena, size);
+  }
+
+  void* result = block->data + block->used;
+  block->used += size;
+  return result;
+}
+
+void* arenaReallocate(Arena* arena, void* pointer, size_t oldSize,
+                      size_t newSize) {
+  if (arena == NULL) return reallocate(pointer, oldSize, newSize);
+  // released with the arena
+  if (newSize == 0) return NULL;
+
+  ArenaBlock* block = arena->blocks;
+  size_t alignedOld = alignSize(oldSize);
+  size_t alignedNew = alignSize(newSize);
+
+  // the last allocation of the current block can grow in place
+  if (pointer != NULL && block != NULL &&
+      (char*)pointer + alignedOld == block->data + block->used &&
+      block->used - alignedOld + alignedNew <= block->size) {
+    block->used = block->used - alignedOld + alignedNew;
+    return pointer;
+  }
+
+  void* result = arenaAllocate(arena, newSize);
+  if (pointer != NULL) {
+    memcpy(result, pointer, oldSize < newSize ? oldSize : newSize);
+  }
+  return result;
+}
+
+void freeArena(Arena* arena) {
+  ArenaBlock* block = arena->blocks;
+  while (block != NULL) {
+    ArenaBlock* next = block->next;
+    reallocate(block, sizeof(ArenaBlock) + block->size, 0);
+    block = next;
+  }
+
+  initArena(arena);
+}
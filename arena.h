@@ -0,0 +1,38 @@
+#ifndef clox_arena_h
+#define clox_arena_h
+
+#include "common.h"
+
+// bump-pointer arena. everything allocated from it is released at once by
+// freeArena(). interpret() uses one for each chunk's code, lines and
+// constant arrays. heap objects never live in an arena: anything the chunk
+// hands out that must outlive it (e.g. borrowed literals) is promoted
+// before the arena goes away.
+#define ARENA_MIN_BLOCK_SIZE 4096
+#define ARENA_ALIGNMENT 16
+
+typedef struct ArenaBlock ArenaBlock;
+typedef struct Arena Arena;
+
+struct Arena {
+  // newest block first. only the newest one is bumped
+  ArenaBlock* blocks;
+  size_t bytesAllocated;
+};
+
+void initArena(Arena* arena);
+void* arenaAllocate(Arena* arena, size_t size);
+// like reallocate(), but from the arena when it's not NULL. growing the
+// most recent allocation extends it in place; freeing is a no-op
+void* arenaReallocate(Arena* arena, void* pointer, size_t oldSize,
+                      size_t newSize);
+void freeArena(Arena* arena);
+
+#define ARENA_GROW_ARRAY(arena, type, pointer, oldCount, newCount) \
+  (type*)arenaReallocate(arena, pointer, sizeof(type) * (oldCount), \
+                         sizeof(type) * (newCount))
+
+#define ARENA_FREE_ARRAY(arena, type, pointer, count) \
+  arenaReallocate(arena, pointer, sizeof(type) * (count), 0)
+
+#endif
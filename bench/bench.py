@@ -0,0 +1,280 @@
+#!/usr/bin/env python3
+"""Builds a release clox, runs the workloads in workloads.py and reports
+median/p95 wall time and peak RSS, compared against a saved baseline.
+
+    bench/bench.py                    # run everything, compare if a baseline exists
+    bench/bench.py --save-baseline    # ...and save the results as the new baseline
+    bench/bench.py --only arith,concat --reps 20
+    bench/bench.py --micro [FILTER]   # C microbenchmarks (microbench.c) instead
+    bench/bench.py --fuzz-numbers [N] # check number parsing/formatting against libc
+    bench/bench.py --intern-max 0,64,100000   # the same workloads per interning cutoff
+    bench/bench.py --sampler-overhead [HZ]    # ...without and with --profile-sample=HZ
+    bench/bench.py --check-literal-copies     # fail if freeing a chunk copies its literals
+"""
+
+import argparse
+import glob
+import json
+import os
+import subprocess
+import sys
+
+from workloads import WORKLOADS
+
+# what --intern-max runs unless --only says otherwise
+CONCAT_WORKLOADS = ["concat", "literals", "intern"]
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+REPO_DIR = os.path.dirname(BENCH_DIR)
+OUT_DIR = os.path.join(BENCH_DIR, "out")
+DEFAULT_BASELINE = os.path.join(OUT_DIR, "baseline.json")
+
+
+def build(cc, cflags):
+    """Builds clox and the runner that measures it. returns both paths."""
+    binary = os.path.join(OUT_DIR, "clox")
+    sources = sorted(glob.glob(os.path.join(REPO_DIR, "*.c")))
+    command = [cc, "-std=gnu11", *cflags.split(), *sources, "-o", binary,
+               "-lm", "-lpthread"]
+    subprocess.run(command, check=True)
+
+    runner = os.path.join(OUT_DIR, "runner")
+    subprocess.run([cc, "-O2", os.path.join(BENCH_DIR, "runner.c"), "-o",
+                    runner], check=True)
+    return binary, runner
+
+
+def build_micro(cc, cflags, name="microbench"):
+    """Builds bench/NAME.c against every clox source but main.c."""
+    binary = os.path.join(OUT_DIR, name)
+    sources = [path for path in sorted(glob.glob(os.path.join(REPO_DIR, "*.c")))
+               if os.path.basename(path) != "main.c"]
+    command = [cc, "-std=gnu11", *cflags.split(), f"-I{REPO_DIR}",
+               os.path.join(BENCH_DIR, f"{name}.c"), *sources, "-o", binary,
+               "-lm", "-lpthread"]
+    subprocess.run(command, check=True)
+    return binary
+
+
+def generate(name):
+    mode, make_source = WORKLOADS[name]
+    path = os.path.join(OUT_DIR, f"{name}.lox")
+    with open(path, "w") as file:
+        file.write(make_source())
+    return mode, path
+
+
+def run_once(tools, mode, path, clox_args=()):
+    """Returns (seconds, peak RSS in KiB, exit status) for one process."""
+    binary, runner = tools
+    args = [runner, binary, *clox_args]
+    if mode == "file":
+        args.append(path)
+    stdin = subprocess.DEVNULL if mode == "file" else open(path, "rb")
+    try:
+        process = subprocess.run(args, stdin=stdin,
+                                 stdout=subprocess.DEVNULL,
+                                 stderr=subprocess.PIPE, check=True)
+    finally:
+        if stdin is not subprocess.DEVNULL:
+            stdin.close()
+
+    seconds, rss, status = process.stderr.decode().split()
+    return float(seconds), int(rss), int(status)
+
+
+def percentile(sorted_values, fraction):
+    # nearest rank
+    index = max(0, min(len(sorted_values) - 1,
+                       int(round(fraction * len(sorted_values))) - 1))
+    return sorted_values[index]
+
+
+def summarize(times, peak_rss):
+    times = sorted(times)
+    return {
+        "median": percentile(times, 0.5),
+        "p95": percentile(times, 0.95),
+        "peak_rss_kib": peak_rss,
+    }
+
+
+def measure_each(tools, name, warmup, reps, arg_sets):
+    """Measures the workload once per set of clox arguments. the sets take
+    turns rep by rep, so drift in the machine's speed hits them all alike."""
+    mode, path = generate(name)
+    for _ in range(warmup):
+        for clox_args in arg_sets:
+            run_once(tools, mode, path, clox_args)
+
+    times = [[] for _ in arg_sets]
+    peak_rss = [0 for _ in arg_sets]
+    for _ in range(reps):
+        for i, clox_args in enumerate(arg_sets):
+            elapsed, rss, status = run_once(tools, mode, path, clox_args)
+            if status != 0:
+                sys.exit(f"{name}: clox exited with status {status}")
+            times[i].append(elapsed)
+            peak_rss[i] = max(peak_rss[i], rss)
+
+    return [summarize(times[i], peak_rss[i]) for i in range(len(arg_sets))]
+
+
+def measure(tools, name, warmup, reps):
+    return measure_each(tools, name, warmup, reps, [()])[0]
+
+
+def change(new, old):
+    return 100.0 * (new - old) / old if old else 0.0
+
+
+def report(results, baseline, threshold):
+    """Prints one row per workload. returns the names that regressed."""
+    header = f"{'workload':<12} {'median ms':>10} {'p95 ms':>10} {'rss KiB':>9}"
+    if baseline:
+        header += f" {'vs base':>8} {'rss vs':>8}"
+    print(header)
+
+    regressions = []
+    for name, result in results.items():
+        row = (f"{name:<12} {result['median'] * 1000:>10.2f} "
+               f"{result['p95'] * 1000:>10.2f} {result['peak_rss_kib']:>9}")
+        base = baseline.get(name) if baseline else None
+        if base:
+            time_change = change(result["median"], base["median"])
+            rss_change = change(result["peak_rss_kib"], base["peak_rss_kib"])
+            row += f" {time_change:>+7.1f}% {rss_change:>+7.1f}%"
+            if time_change > threshold or rss_change > threshold:
+                row += "  REGRESSION"
+                regressions.append(name)
+        print(row)
+
+    return regressions
+
+
+def compare_runs(tools, names, arg_sets, warmup, reps):
+    """Runs the workloads once per set of clox arguments, each compared
+    with the first."""
+    per_name = {name: measure_each(tools, name, warmup, reps, arg_sets)
+                for name in names}
+    first = None
+    for i, clox_args in enumerate(arg_sets):
+        results = {name: per_name[name][i] for name in names}
+        print(" ".join(clox_args) or "(no arguments)")
+        # a comparison, not a gate: nothing is flagged
+        report(results, first, float("inf"))
+        print()
+        first = first or results
+
+
+def check_literal_copies(binary, names):
+    """Runs each workload once with --stats=json and fails if any borrowed
+    literal was copied when its chunk was freed. nothing in them outlives
+    a chunk, so every literal must be released without a copy."""
+    print(f"{'workload':<12} {'promoted':>10} {'detached':>10}")
+    failed = []
+    for name in names:
+        mode, path = generate(name)
+        args = [binary, "--stats=json"]
+        if mode == "file":
+            args.append(path)
+        with open(path if mode == "repl" else os.devnull, "rb") as stdin:
+            process = subprocess.run(args, stdin=stdin,
+                                     stdout=subprocess.DEVNULL,
+                                     stderr=subprocess.PIPE, check=True)
+        stats = json.loads(process.stderr.decode().splitlines()[-1])
+        promoted, detached = stats["promotedStrings"], stats["detachedStrings"]
+        row = f"{name:<12} {promoted:>10} {detached:>10}"
+        if promoted != 0:
+            row += "  FAIL"
+            failed.append(name)
+        print(row)
+    return 1 if failed else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument("--only", help="comma-separated workload names")
+    parser.add_argument("--reps", type=int, default=10)
+    parser.add_argument("--warmup", type=int, default=1)
+    parser.add_argument("--cc", default=os.environ.get("CC", "cc"))
+    parser.add_argument("--cflags", default="-O2 -DNDEBUG",
+                        help="release flags (default: %(default)s)")
+    parser.add_argument("--baseline", default=DEFAULT_BASELINE,
+                        help="baseline to compare with (default: %(default)s)")
+    parser.add_argument("--save-baseline", action="store_true",
+                        help="save these results as the baseline")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="%% slowdown flagged as a regression")
+    parser.add_argument("--micro", nargs="?", const="", metavar="FILTER",
+                        help="run the C microbenchmarks whose names contain FILTER")
+    parser.add_argument("--fuzz-numbers", nargs="?", const=1000000, type=int,
+                        metavar="N",
+                        help="compare parseNumber() with strtod() and formatNumber() with %%g\n"
+                             "on N inputs of each kind")
+    parser.add_argument("--intern-max", metavar="CUTOFFS",
+                        help="comma-separated interning cutoffs to compare, on the\n"
+                             f"concatenation workloads ({', '.join(CONCAT_WORKLOADS)}) by default")
+    parser.add_argument("--check-literal-copies", action="store_true",
+                        help="check that freeing a chunk copies none of its literals, on the\n"
+                             f"concatenation workloads ({', '.join(CONCAT_WORKLOADS)}) by default")
+    parser.add_argument("--sampler-overhead", nargs="?", const=1000, type=int,
+                        metavar="HZ",
+                        help="compare the workloads without and with --profile-sample=HZ")
+    args = parser.parse_args()
+
+    if args.micro is not None:
+        os.makedirs(OUT_DIR, exist_ok=True)
+        binary = build_micro(args.cc, args.cflags)
+        return subprocess.run([binary, args.micro]).returncode
+
+    if args.fuzz_numbers is not None:
+        os.makedirs(OUT_DIR, exist_ok=True)
+        binary = build_micro(args.cc, args.cflags, "fuzznumber")
+        return subprocess.run([binary, str(args.fuzz_numbers)]).returncode
+
+    uses_concat = args.intern_max or args.check_literal_copies
+    default_names = CONCAT_WORKLOADS if uses_concat else list(WORKLOADS)
+    names = args.only.split(",") if args.only else default_names
+    for name in names:
+        if name not in WORKLOADS:
+            sys.exit(f"unknown workload: {name} (have {', '.join(WORKLOADS)})")
+
+    os.makedirs(OUT_DIR, exist_ok=True)
+    tools = build(args.cc, args.cflags)
+
+    if args.check_literal_copies:
+        return check_literal_copies(tools[0], names)
+
+    if args.intern_max:
+        arg_sets = [[f"--intern-max={int(cutoff)}"]
+                    for cutoff in args.intern_max.split(",")]
+        compare_runs(tools, names, arg_sets, args.warmup, args.reps)
+        return 0
+
+    if args.sampler_overhead is not None:
+        arg_sets = [[], [f"--profile-sample={args.sampler_overhead}"]]
+        compare_runs(tools, names, arg_sets, args.warmup, args.reps)
+        return 0
+
+    results = {name: measure(tools, name, args.warmup, args.reps)
+               for name in names}
+
+    baseline = None
+    if os.path.exists(args.baseline) and not args.save_baseline:
+        with open(args.baseline) as file:
+            baseline = json.load(file)
+
+    regressions = report(results, baseline, args.threshold)
+
+    if args.save_baseline:
+        with open(args.baseline, "w") as file:
+            json.dump(results, file, indent=2)
+        print(f"saved baseline to {args.baseline}")
+
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,279 @@
+// checks parseNumber() against strtod() on random literals of the
+// scanner's number grammar, and formatNumber() against printf("%g") on
+// random doubles. linked like microbench.c; bench/bench.py --fuzz-numbers
+// builds and runs it, or:
+//
+//   cc -std=gnu11 -O2 -I. bench/fuzznumber.c $(ls *.c | grep -v
+//   '^main.c$') -o fuzznumber -lm -lpthread && ./fuzznumber [COUNT]
+//
+// literals come from random digit strings, from random doubles printed at
+// random precisions, and from the exact midpoints between neighbouring
+// doubles and the literals either side of them, where rounding is
+// hardest. doubles come from random bit patterns, integers, short
+// decimals, and values whose seventh significant digit is a tie. prints
+// each input the two sides disagree on and exits 1 if any
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "number.h"
+
+// long enough for the exact expansion of any midpoint generated below
+#define LITERAL_MAX 2048
+#define MISMATCH_LIMIT 20
+
+static uint64_t rngState = 88172645463325252u;
+
+static uint64_t nextRandom() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return rngState;
+}
+
+//---------- START PARSING ------------//
+typedef enum {
+  LITERAL_DIGITS,
+  LITERAL_PRINTED,
+  LITERAL_MIDPOINT,
+  LITERAL_KIND_COUNT
+} LiteralKind;
+
+static const char* literalKindNames[LITERAL_KIND_COUNT] = {
+    [LITERAL_DIGITS] = "digits",
+    [LITERAL_PRINTED] = "printed",
+    [LITERAL_MIDPOINT] = "midpoint",
+};
+
+static int randomDigits(char* buffer, int length, bool isZeroHeavy) {
+  for (int i = 0; i < length; i++) {
+    buffer[i] = isZeroHeavy && nextRandom() % 4 != 0
+                    ? '0'
+                    : (char)('0' + nextRandom() % 10);
+  }
+  return length;
+}
+
+// a double with a random bit pattern and a decimal exponent in
+// [-maxPower, maxPower]
+static double randomDouble(int maxPower) {
+  for (;;) {
+    uint64_t bits = nextRandom() >> 1;
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    if (isfinite(value) && value != 0.0 &&
+        fabs(log10(value)) <= maxPower) {
+      return value;
+    }
+  }
+}
+
+static void trimZeros(char* literal) {
+  char* point = strchr(literal, '.');
+  if (point == NULL) return;
+  char* end = literal + strlen(literal);
+  while (end[-1] == '0') end--;
+  if (end[-1] == '.') end--;
+  *end = '\0';
+}
+
+// writes a literal of the given kind, returning its length
+static int makeLiteral(char* buffer, LiteralKind kind) {
+  switch (kind) {
+    case LITERAL_DIGITS: {
+      // a few runs of digits long enough to need the fallback
+      int integerLength = 1 + nextRandom() % (nextRandom() % 8 == 0 ? 400 : 25);
+      int fractionLength = nextRandom() % (nextRandom() % 8 == 0 ? 900 : 30);
+      bool isZeroHeavy = nextRandom() % 3 == 0;
+      int length = randomDigits(buffer, integerLength, isZeroHeavy);
+      if (fractionLength > 0) {
+        buffer[length++] = '.';
+        length += randomDigits(buffer + length, fractionLength, isZeroHeavy);
+      }
+      buffer[length] = '\0';
+      return length;
+    }
+    case LITERAL_PRINTED: {
+      double value = randomDouble(nextRandom() % 2 ? 20 : 120);
+      int precision = nextRandom() % 2 ? (int)(nextRandom() % 25) : 17;
+      // %f prints the whole integer part, so keep precision small for
+      // large values and large for small ones
+      if (value < 1e-6) precision += 20 + (int)-log10(value);
+      snprintf(buffer, LITERAL_MAX, "%.*f", precision, value);
+      trimZeros(buffer);
+      return (int)strlen(buffer);
+    }
+    case LITERAL_MIDPOINT: {
+      // long double holds the 54 bits of the midpoint exactly
+      double value = randomDouble(30);
+      long double midpoint =
+          ((long double)value + (long double)nextafter(value, INFINITY)) / 2;
+      snprintf(buffer, LITERAL_MAX, "%.1100Lf", midpoint);
+      trimZeros(buffer);
+      int length = (int)strlen(buffer);
+      // the midpoint itself, or a nudge either side of it
+      switch (nextRandom() % 3) {
+        case 0:
+          break;
+        case 1:
+          if (strchr(buffer, '.') == NULL) buffer[length++] = '.';
+          buffer[length++] = '0';
+          buffer[length++] = '1';
+          buffer[length] = '\0';
+          break;
+        case 2: {
+          // one less in the last place, borrowing, then 99 after it
+          for (int i = length - 1; i >= 0; i--) {
+            if (buffer[i] == '.') continue;
+            if (buffer[i] != '0') {
+              buffer[i]--;
+              break;
+            }
+            buffer[i] = '9';
+          }
+          if (strchr(buffer, '.') == NULL) buffer[length++] = '.';
+          buffer[length++] = '9';
+          buffer[length++] = '9';
+          buffer[length] = '\0';
+          break;
+        }
+      }
+      return length;
+    }
+    default:
+      return 0;
+  }
+}
+
+static long fuzzParsing(long count) {
+  static char literal[LITERAL_MAX + 8];
+  long mismatches = 0;
+  for (int kind = 0; kind < LITERAL_KIND_COUNT; kind++) {
+    for (long i = 0; i < count; i++) {
+      int length = makeLiteral(literal, kind);
+      double parsed = parseNumber(literal, length);
+      // characters strtod() would read on into, which parseNumber() must
+      // stop before
+      literal[length] = 'e';
+      literal[length + 1] = '7';
+      literal[length + 2] = '\0';
+      double parsedBeforeE = parseNumber(literal, length);
+      literal[length] = '\0';
+      double expected = strtod(literal, NULL);
+
+      if (memcmp(&parsed, &expected, sizeof(double)) != 0 ||
+          memcmp(&parsedBeforeE, &expected, sizeof(double)) != 0) {
+        if (mismatches++ < MISMATCH_LIMIT) {
+          printf("%s: %s\n  parseNumber %.17g, strtod %.17g\n",
+                 literalKindNames[kind], literal, parsed, expected);
+        }
+      }
+    }
+    printf("parse %-10s %ld literals\n", literalKindNames[kind], count);
+  }
+  return mismatches;
+}
+//---------- END PARSING ------------//
+
+//---------- START FORMATTING ------------//
+typedef enum {
+  DOUBLE_BITS,
+  DOUBLE_INTEGER,
+  DOUBLE_DECIMAL,
+  DOUBLE_TIE,
+  DOUBLE_KIND_COUNT
+} DoubleKind;
+
+static const char* doubleKindNames[DOUBLE_KIND_COUNT] = {
+    [DOUBLE_BITS] = "bits",
+    [DOUBLE_INTEGER] = "integer",
+    [DOUBLE_DECIMAL] = "decimal",
+    [DOUBLE_TIE] = "tie",
+};
+
+static double makeDouble(DoubleKind kind) {
+  double value;
+  switch (kind) {
+    case DOUBLE_BITS: {
+      // every exponent equally likely, nan, inf and subnormals included
+      uint64_t bits = nextRandom();
+      memcpy(&value, &bits, sizeof(value));
+      return value;
+    }
+    case DOUBLE_INTEGER:
+      // up to 2^64 and a little past it, as often small as large
+      value = (double)(nextRandom() >> (nextRandom() % 64));
+      if (nextRandom() % 16 == 0) value *= 4;
+      break;
+    case DOUBLE_DECIMAL: {
+      // what a short literal parses to
+      static const double powers[] = {1e1,  1e2,  1e3,  1e4,  1e5, 1e6,
+                                      1e7,  1e8,  1e9,  1e10, 1e15, 1e20};
+      value = (double)(nextRandom() % 100000000) /
+              powers[nextRandom() % (sizeof(powers) / sizeof(double))];
+      break;
+    }
+    case DOUBLE_TIE: {
+      // seven significant digits ending in 5, exact in binary: an integer,
+      // or a halved one. a power of ten moves the tie to digits the binary
+      // value only comes close to. then maybe an ulp either side
+      value = (double)(1000000 + nextRandom() % 9000000 / 10 * 10 + 5);
+      switch (nextRandom() % 4) {
+        case 0:
+          break;
+        case 1:
+          value /= 10;
+          break;
+        case 2:
+          value *= pow(10, (double)(nextRandom() % 20));
+          break;
+        case 3:
+          value /= pow(10, (double)(nextRandom() % 20));
+          break;
+      }
+      if (nextRandom() % 3 == 0) value = nextafter(value, INFINITY);
+      if (nextRandom() % 3 == 0) value = nextafter(value, 0);
+      break;
+    }
+    default:
+      return 0;
+  }
+  return nextRandom() % 2 ? -value : value;
+}
+
+static long fuzzFormatting(long count) {
+  long mismatches = 0;
+  for (int kind = 0; kind < DOUBLE_KIND_COUNT; kind++) {
+    for (long i = 0; i < count; i++) {
+      double value = makeDouble(kind);
+      char formatted[NUMBER_FORMAT_MAX];
+      char expected[NUMBER_FORMAT_MAX];
+      int length = formatNumber(value, formatted);
+      snprintf(expected, sizeof(expected), "%g", value);
+
+      if (strcmp(formatted, expected) != 0 ||
+          length != (int)strlen(expected)) {
+        if (mismatches++ < MISMATCH_LIMIT) {
+          printf("%s: %.17g\n  formatNumber %s, %%g %s\n",
+                 doubleKindNames[kind], value, formatted, expected);
+        }
+      }
+    }
+    printf("format %-9s %ld doubles\n", doubleKindNames[kind], count);
+  }
+  return mismatches;
+}
+//---------- END FORMATTING ------------//
+
+int main(int argc, const char* argv[]) {
+  if (argc > 2) {
+    fprintf(stderr, "Usage: fuzznumber [count]\n");
+    return 64;
+  }
+  long count = argc == 2 ? atol(argv[1]) : 1000000;
+
+  long mismatches = fuzzParsing(count) + fuzzFormatting(count);
+  printf("%ld mismatches\n", mismatches);
+  return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,973 @@
+// microbenchmarks for the data structures under the VM: Table, string
+// interning and hashing, chunk writing, scanner throughput and number
+// parsing and formatting. linked against every clox
+// source but main.c; bench/bench.py --micro builds and runs it, or:
+//
+//   cc -std=gnu11 -O2 -DNDEBUG -I. bench/microbench.c $(ls *.c | grep -v
+//   '^main.c$') -o microbench -lm -lpthread
+//
+// each case sets up its keys untimed, then times whole passes over them
+// and reports the median ns/op of a few runs. table cases also report the
+// probe lengths recorded in vm.metrics while timing: the mean number of
+// groups probed per lookup and the share that needed more than one.
+// internProbes cases do the same through vm.strings itself, for
+// hashString() and for FNV-1a, and add full-hash collisions and the whole
+// probe histogram.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "chunk.h"
+#include "memory.h"
+#include "metrics.h"
+#include "number.h"
+#include "object.h"
+#include "scanner.h"
+#include "table.h"
+#include "vm.h"
+
+#ifdef DEBUG_STRESS_GC
+// the benchmark keys aren't GC roots, so they can't survive a collection
+// on every allocation
+#error "microbench can't be built with DEBUG_STRESS_GC"
+#endif
+
+// every timed run performs at least this many operations
+#define MIN_OPS (1 << 20)
+#define RUNS 5
+
+typedef enum {
+  KEYS_SEQUENTIAL,  // "k0", "k1", ...: short and similar
+  KEYS_RANDOM,      // 4 to 24 random letters
+  KEYS_PREFIXED,    // a long shared prefix, differing only at the end
+  KEYS_LONG,        // 100 to 200 random letters, past internMaxLength
+  KEYS_IDENTIFIERS, // camelCase words, like the names in a program
+  KEY_KIND_COUNT
+} KeyKind;
+
+static const char* keyKindNames[KEY_KIND_COUNT] = {
+    [KEYS_SEQUENTIAL] = "seq",
+    [KEYS_RANDOM] = "random",
+    [KEYS_PREFIXED] = "prefixed",
+    [KEYS_LONG] = "long",
+    [KEYS_IDENTIFIERS] = "identifiers",
+};
+
+static const char* identifierWords[] = {
+    "get",   "set",    "user",  "name",  "count", "index", "value", "node",
+    "list",  "item",   "total", "is",    "has",   "parse", "token", "line",
+    "start", "end",    "next",  "prev",  "size",  "table", "key",   "entry",
+    "make",  "update", "read",  "write", "file",  "path",  "error", "result"};
+#define IDENTIFIER_WORD_COUNT \
+  (int)(sizeof(identifierWords) / sizeof(identifierWords[0]))
+
+static const int tableSizes[] = {16, 4096, 262144};
+#define TABLE_SIZE_COUNT (int)(sizeof(tableSizes) / sizeof(tableSizes[0]))
+
+static const char* filter = NULL;
+
+//---------- START KEYS ------------//
+// xorshift, so key sets are the same on every run
+static uint64_t rngState;
+
+static uint64_t nextRandom() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 7;
+  rngState ^= rngState << 17;
+  return rngState;
+}
+
+static void randomLetters(char* buffer, int length) {
+  for (int i = 0; i < length; i++) {
+    buffer[i] = 'a' + nextRandom() % 26;
+  }
+}
+
+// writes key number i of the given kind into buffer, returning its length.
+// the same (kind, i, seed) always gives the same key
+static int makeKey(char* buffer, KeyKind kind, int i, uint64_t seed) {
+  rngState = seed * 0x9E3779B97F4A7C15u + (uint64_t)i * 0xBF58476D1CE4E5B9u + 1;
+  switch (kind) {
+    case KEYS_SEQUENTIAL:
+      return sprintf(buffer, "k%d_%llu", i, (unsigned long long)seed);
+    case KEYS_RANDOM: {
+      int length = 4 + nextRandom() % 21;
+      randomLetters(buffer, length);
+      // the index keeps keys distinct
+      return length + sprintf(buffer + length, "%d", i);
+    }
+    case KEYS_PREFIXED:
+      return sprintf(buffer, "some.long.shared.module.prefix.%llu.name%d",
+                     (unsigned long long)seed, i);
+    case KEYS_LONG: {
+      int length = 100 + nextRandom() % 101;
+      randomLetters(buffer, length);
+      return length + sprintf(buffer + length, "%d", i);
+    }
+    case KEYS_IDENTIFIERS: {
+      // two or three words, then the index to keep them distinct
+      int length = 0;
+      int words = 2 + nextRandom() % 2;
+      for (int w = 0; w < words; w++) {
+        const char* word =
+            identifierWords[nextRandom() % IDENTIFIER_WORD_COUNT];
+        length += sprintf(buffer + length, "%s", word);
+        if (w > 0) buffer[length - strlen(word)] -= 'a' - 'A';
+      }
+      return length + sprintf(buffer + length, "%d", i);
+    }
+    default:
+      return 0;
+  }
+}
+
+// interned keys, so tables can compare them by identity. seed 0 is used
+// for keys put in tables and seed 1 for keys that miss
+static ObjString** makeKeys(KeyKind kind, int count, uint64_t seed) {
+  ObjString** keys = malloc(sizeof(ObjString*) * count);
+  char buffer[256];
+  for (int i = 0; i < count; i++) {
+    int length = makeKey(buffer, kind, i, seed);
+    keys[i] = internString(buffer, length);
+  }
+  return keys;
+}
+//---------- END KEYS ------------//
+
+//---------- START REPORTING ------------//
+static int compareDoubles(const void* a, const void* b) {
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+static double median(double* values, int count) {
+  qsort(values, count, sizeof(double), compareDoubles);
+  return values[count / 2];
+}
+
+static void resetProbes() {
+  memset(vm.metrics.probeLengths, 0, sizeof(vm.metrics.probeLengths));
+}
+
+static void printHeader() {
+  printf("%-32s %8s %5s %10s %10s %8s\n", "case", "size", "hit%", "ns/op",
+         "groups", ">1 grp%");
+}
+
+// probe columns are left blank for cases that don't look anything up
+static void report(const char* name, int size, int hitPercent, double nsPerOp,
+                   bool hasProbes) {
+  printf("%-32s %8d ", name, size);
+  if (hitPercent >= 0) {
+    printf("%5d", hitPercent);
+  } else {
+    printf("%5s", "");
+  }
+  printf(" %10.2f", nsPerOp);
+
+  uint64_t lookups = 0, groups = 0;
+  for (int i = 0; i < PROBE_HISTOGRAM_SIZE; i++) {
+    lookups += vm.metrics.probeLengths[i];
+    groups += vm.metrics.probeLengths[i] * (i + 1);
+  }
+  if (hasProbes && lookups > 0) {
+    printf(" %10.3f %7.2f%%", (double)groups / lookups,
+           100.0 * (lookups - vm.metrics.probeLengths[0]) / lookups);
+  }
+  printf("\n");
+}
+
+static bool isSelected(const char* name) {
+  return filter == NULL || strstr(name, filter) != NULL;
+}
+
+// frees everything the case allocated: nothing it made is a GC root
+static void endCase() {
+  collectGarbage();
+  vm.nextGC = (size_t)-1;
+}
+
+static int passesFor(int size) {
+  return size >= MIN_OPS ? 1 : MIN_OPS / size;
+}
+//---------- END REPORTING ------------//
+
+//---------- START TABLE CASES ------------//
+// gets from a full table. hitPercent of the lookups find their key
+static void benchTableGet(KeyKind kind, int size, int hitPercent) {
+  char name[64];
+  snprintf(name, sizeof(name), "tableGet/%s", keyKindNames[kind]);
+  if (!isSelected(name)) return;
+
+  ObjString** keys = makeKeys(kind, size, 0);
+  ObjString** misses = makeKeys(kind, size, 1);
+  Table table;
+  initTable(&table);
+  table.metrics = &vm.metrics;
+  for (int i = 0; i < size; i++) tableSet(&table, keys[i], NUMBER_VAL(i));
+
+  // the lookup order interleaves hits and misses evenly
+  ObjString** lookups = malloc(sizeof(ObjString*) * size);
+  for (int i = 0; i < size; i++) {
+    bool isHit = (i * 100 / size) < hitPercent;
+    lookups[i] = isHit ? keys[i] : misses[i];
+  }
+  for (int i = size - 1; i > 0; i--) {
+    int j = nextRandom() % (i + 1);
+    ObjString* swap = lookups[i];
+    lookups[i] = lookups[j];
+    lookups[j] = swap;
+  }
+
+  int passes = passesFor(size);
+  double runs[RUNS];
+  volatile int found = 0;
+  for (int run = 0; run < RUNS; run++) {
+    resetProbes();
+    uint64_t start = metricsNow();
+    for (int pass = 0; pass < passes; pass++) {
+      for (int i = 0; i < size; i++) {
+        Value value;
+        found += tableGet(&table, lookups[i], &value);
+      }
+    }
+    runs[run] = (double)(metricsNow() - start) / ((double)passes * size);
+  }
+  report(name, size, hitPercent, median(runs, RUNS), true);
+
+  freeTable(&table);
+  free(lookups);
+  free(keys);
+  free(misses);
+  endCase();
+}
+
+// inserts into an empty table, growing it from nothing
+static void benchTableInsert(KeyKind kind, int size, bool isIncremental) {
+  char name[64];
+  snprintf(name, sizeof(name), "tableSet/%s%s", keyKindNames[kind],
+           isIncremental ? "/incremental" : "");
+  if (!isSelected(name)) return;
+
+  ObjString** keys = makeKeys(kind, size, 0);
+  int passes = passesFor(size);
+  double runs[RUNS];
+  for (int run = 0; run < RUNS; run++) {
+    resetProbes();
+    uint64_t elapsed = 0;
+    for (int pass = 0; pass < passes; pass++) {
+      Table table;
+      initTable(&table);
+      table.metrics = &vm.metrics;
+      table.isIncremental = isIncremental;
+      uint64_t start = metricsNow();
+      for (int i = 0; i < size; i++) tableSet(&table, keys[i], NUMBER_VAL(i));
+      elapsed += metricsNow() - start;
+      freeTable(&table);
+    }
+    runs[run] = (double)elapsed / ((double)passes * size);
+  }
+  report(name, size, -1, median(runs, RUNS), true);
+
+  free(keys);
+  endCase();
+}
+
+// overwrites the value of keys already in the table
+static void benchTableOverwrite(KeyKind kind, int size) {
+  char name[64];
+  snprintf(name, sizeof(name), "tableSet/%s/overwrite", keyKindNames[kind]);
+  if (!isSelected(name)) return;
+
+  ObjString** keys = makeKeys(kind, size, 0);
+  Table table;
+  initTable(&table);
+  table.metrics = &vm.metrics;
+  for (int i = 0; i < size; i++) tableSet(&table, keys[i], NUMBER_VAL(i));
+
+  int passes = passesFor(size);
+  double runs[RUNS];
+  for (int run = 0; run < RUNS; run++) {
+    resetProbes();
+    uint64_t start = metricsNow();
+    for (int pass = 0; pass < passes; pass++) {
+      for (int i = 0; i < size; i++) {
+        tableSet(&table, keys[i], NUMBER_VAL(pass));
+      }
+    }
+    runs[run] = (double)(metricsNow() - start) / ((double)passes * size);
+  }
+  report(name, size, 100, median(runs, RUNS), true);
+
+  freeTable(&table);
+  free(keys);
+  endCase();
+}
+
+// deletes half the keys then puts them back, so every op is a hit and the
+// table keeps running into its own tombstones
+static void benchTableChurn(KeyKind kind, int size) {
+  char name[64];
+  snprintf(name, sizeof(name), "tableDelete/%s/churn", keyKindNames[kind]);
+  if (!isSelected(name)) return;
+
+  ObjString** keys = makeKeys(kind, size, 0);
+  Table table;
+  initTable(&table);
+  table.metrics = &vm.metrics;
+  for (int i = 0; i < size; i++) tableSet(&table, keys[i], NUMBER_VAL(i));
+
+  int passes = passesFor(size);
+  double runs[RUNS];
+  for (int run = 0; run < RUNS; run++) {
+    resetProbes();
+    uint64_t start = metricsNow();
+    for (int pass = 0; pass < passes; pass++) {
+      for (int i = pass & 1; i < size; i += 2) tableDelete(&table, keys[i]);
+      for (int i = pass & 1; i < size; i += 2) {
+        tableSet(&table, keys[i], NUMBER_VAL(i));
+      }
+    }
+    // a delete and a set per key touched
+    runs[run] = (double)(metricsNow() - start) / ((double)passes * size);
+  }
+  report(name, size, 100, median(runs, RUNS), true);
+
+  freeTable(&table);
+  free(keys);
+  endCase();
+}
+
+// looks keys up by their chars, the way interning does, in a table of its
+// own so vm.strings' size doesn't matter
+static void benchTableFindString(KeyKind kind, int size, int hitPercent) {
+  char name[64];
+  snprintf(name, sizeof(name), "tableFindString/%s", keyKindNames[kind]);
+  if (!isSelected(name)) return;
+
+  ObjString** keys = makeKeys(kind, size, 0);
+  Table table;
+  initTable(&table);
+  table.metrics = &vm.metrics;
+  for (int i = 0; i < size; i++) tableSet(&table, keys[i], NIL_VAL());
+
+  // probes use copies of the chars, so nothing matches by pointer
+  char** chars = malloc(sizeof(char*) * size);
+  int* lengths = malloc(sizeof(int) * size);
+  uint32_t* hashes = malloc(sizeof(uint32_t) * size);
+  char buffer[256];
+  for (int i = 0; i < size; i++) {
+    bool isHit = (i * 100 / size) < hitPercent;
+    lengths[i] = makeKey(buffer, kind, i, isHit ? 0 : 1);
+    chars[i] = malloc(lengths[i]);
+    memcpy(chars[i], buffer, lengths[i]);
+    hashes[i] = hashString(chars[i], lengths[i]);
+  }
+
+  int passes = passesFor(size);
+  double runs[RUNS];
+  volatile int found = 0;
+  for (int run = 0; run < RUNS; run++) {
+    resetProbes();
+    uint64_t start = metricsNow();
+    for (int pass = 0; pass < passes; pass++) {
+      for (int i = 0; i < size; i++) {
+        found += tableFindString(&table, chars[i], lengths[i], hashes[i]) !=
+                 NULL;
+      }
+    }
+    runs[run] = (double)(metricsNow() - start) / ((double)passes * size);
+  }
+  report(name, size, hitPercent, median(runs, RUNS), true);
+
+  for (int i = 0; i < size; i++) free(chars[i]);
+  free(chars);
+  free(lengths);
+  free(hashes);
+  freeTable(&table);
+  free(keys);
+  endCase();
+}
+
+// log2 buckets: bucket i holds latencies in [2^i, 2^(i+1)) ns
+#define LATENCY_BUCKETS 40
+
+static int compareUint64s(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*)a;
+  uint64_t y = *(const uint64_t*)b;
+  return (x > y) - (x < y);
+}
+
+// times every tableSet() while a table grows to size keys, and prints the
+// latency percentiles and histogram. a stop-the-world table rehashes
+// everything inside the tableSet() that crosses the load limit; an
+// incremental one spreads that work over the calls after it
+static void benchTableSetLatency(int size, bool isIncremental) {
+  char name[64];
+  snprintf(name, sizeof(name), "tableSetLatency/%s",
+           isIncremental ? "incremental" : "stop-the-world");
+  if (!isSelected(name)) return;
+
+  ObjString** keys = makeKeys(KEYS_SEQUENTIAL, size, 0);
+  uint64_t* latencies = malloc(sizeof(uint64_t) * size);
+  Table table;
+  initTable(&table);
+  table.metrics = &vm.metrics;
+  table.isIncremental = isIncremental;
+
+  uint64_t total = 0;
+  for (int i = 0; i < size; i++) {
+    uint64_t start = metricsNow();
+    tableSet(&table, keys[i], NUMBER_VAL(i));
+    latencies[i] = metricsNow() - start;
+    total += latencies[i];
+  }
+
+  int histogram[LATENCY_BUCKETS] = {0};
+  for (int i = 0; i < size; i++) {
+    int bucket = 63 - __builtin_clzll(latencies[i] | 1);
+    if (bucket >= LATENCY_BUCKETS) bucket = LATENCY_BUCKETS - 1;
+    histogram[bucket]++;
+  }
+  qsort(latencies, size, sizeof(uint64_t), compareUint64s);
+
+  // ns/op is the mean, clock reads included
+  report(name, size, -1, (double)total / size, false);
+  printf("%-32s %8s   p50 %llu ns, p99 %llu ns, p99.9 %llu ns, max %llu ns\n",
+         "", "", (unsigned long long)latencies[size / 2],
+         (unsigned long long)latencies[(int)(size * 0.99)],
+         (unsigned long long)latencies[(int)(size * 0.999)],
+         (unsigned long long)latencies[size - 1]);
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    if (histogram[i] == 0) continue;
+    printf("%-32s %8s   %10llu ns+ %10d\n", "", "", 1ull << i,
+           histogram[i]);
+  }
+
+  freeTable(&table);
+  free(latencies);
+  free(keys);
+  endCase();
+}
+
+// FNV-1a, hashString()'s predecessor, for comparison
+static uint32_t hashFnv1a(const char* key, int length) {
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < length; i++) {
+    hash ^= (uint8_t)key[i];
+    hash *= 16777619;
+  }
+  return hash;
+}
+
+static int compareHashes(const void* a, const void* b) {
+  uint32_t x = *(const uint32_t*)a;
+  uint32_t y = *(const uint32_t*)b;
+  return (x > y) - (x < y);
+}
+
+// interns size keys into vm.strings itself, the way the compiler does,
+// then interns them all again: every lookup hits. reports the full 32-bit
+// hash collisions among the keys and the probe lengths of the lookups.
+// with isFnv, the keys go into vm.strings under FNV-1a hashes instead
+static void benchInternProbes(KeyKind kind, int size, bool isFnv) {
+  char name[64];
+  snprintf(name, sizeof(name), "internProbes/%s%s", keyKindNames[kind],
+           isFnv ? "/fnv1a" : "");
+  if (!isSelected(name)) return;
+
+  // a fresh VM: vm.strings holds the builtins' names and these keys only
+  freeVM();
+  initVM();
+  vm.nextGC = (size_t)-1;
+
+  char** chars = malloc(sizeof(char*) * size);
+  int* lengths = malloc(sizeof(int) * size);
+  uint32_t* hashes = malloc(sizeof(uint32_t) * size);
+  char buffer[256];
+  for (int i = 0; i < size; i++) {
+    lengths[i] = makeKey(buffer, kind, i, 0);
+    chars[i] = malloc(lengths[i]);
+    memcpy(chars[i], buffer, lengths[i]);
+    hashes[i] = isFnv ? hashFnv1a(chars[i], lengths[i])
+                      : hashString(chars[i], lengths[i]);
+
+    if (!isFnv) {
+      internString(chars[i], lengths[i]);
+    } else {
+      // what internString() does, with the other hash
+      ObjString* string = allocateString(lengths[i]);
+      memcpy(string->chars, chars[i], lengths[i]);
+      string->hash = hashes[i];
+      string->isHashed = true;
+      string->isInterned = true;
+      tableSet(&vm.strings, string, NIL_VAL());
+    }
+  }
+
+  int passes = passesFor(size);
+  double runs[RUNS];
+  volatile int found = 0;
+  for (int run = 0; run < RUNS; run++) {
+    resetProbes();
+    uint64_t start = metricsNow();
+    for (int pass = 0; pass < passes; pass++) {
+      for (int i = 0; i < size; i++) {
+        uint32_t hash = isFnv ? hashFnv1a(chars[i], lengths[i])
+                              : hashString(chars[i], lengths[i]);
+        found += tableFindString(&vm.strings, chars[i], lengths[i], hash) !=
+                 NULL;
+      }
+    }
+    // hashing included: it's part of every intern
+    runs[run] = (double)(metricsNow() - start) / ((double)passes * size);
+  }
+  report(name, size, 100, median(runs, RUNS), true);
+
+  qsort(hashes, size, sizeof(uint32_t), compareHashes);
+  int collisions = 0;
+  for (int i = 1; i < size; i++) collisions += hashes[i] == hashes[i - 1];
+  uint64_t lookups = 0;
+  for (int i = 0; i < PROBE_HISTOGRAM_SIZE; i++) {
+    lookups += vm.metrics.probeLengths[i];
+  }
+  printf("%-32s %8s   %d full-hash collisions; groups probed:", "", "",
+         collisions);
+  for (int i = 0; i < PROBE_HISTOGRAM_SIZE; i++) {
+    printf(" %d%s:%.2f%%", i + 1, i == PROBE_HISTOGRAM_SIZE - 1 ? "+" : "",
+           100.0 * vm.metrics.probeLengths[i] / lookups);
+  }
+  printf("\n");
+
+  for (int i = 0; i < size; i++) free(chars[i]);
+  free(chars);
+  free(lengths);
+  free(hashes);
+  freeVM();
+  initVM();
+  vm.nextGC = (size_t)-1;
+}
+//---------- END TABLE CASES ------------//
+
+//---------- START STRING CASES ------------//
+// copyString of chars that are already interned (hits), new (misses, each
+// adding a string to vm.strings) or too long to intern at all
+static void benchCopyString(KeyKind kind, int size, bool isInterned) {
+  // long keys skip the intern table either way
+  bool isSkipped = kind == KEYS_LONG;
+  if (isSkipped && isInterned) return;
+
+  char name[64];
+  snprintf(name, sizeof(name), "copyString/%s/%s", keyKindNames[kind],
+           isSkipped ? "skip" : isInterned ? "hit" : "new");
+  if (!isSelected(name)) return;
+
+  char** chars = malloc(sizeof(char*) * size);
+  int* lengths = malloc(sizeof(int) * size);
+  char buffer[256];
+  for (int i = 0; i < size; i++) {
+    lengths[i] = makeKey(buffer, kind, i, 0);
+    chars[i] = malloc(lengths[i]);
+    memcpy(chars[i], buffer, lengths[i]);
+  }
+
+  // each run ends by collecting what it interned, so new strings are new
+  // again on the next one
+  double runs[RUNS];
+  for (int run = 0; run < RUNS; run++) {
+    if (isInterned) {
+      for (int i = 0; i < size; i++) copyString(chars[i], lengths[i]);
+    }
+
+    resetProbes();
+    uint64_t start = metricsNow();
+    for (int i = 0; i < size; i++) copyString(chars[i], lengths[i]);
+    runs[run] = (double)(metricsNow() - start) / size;
+    endCase();
+  }
+  int hitPercent = isSkipped ? -1 : isInterned ? 100 : 0;
+  report(name, size, hitPercent, median(runs, RUNS), !isSkipped);
+
+  for (int i = 0; i < size; i++) free(chars[i]);
+  free(chars);
+  free(lengths);
+}
+
+// takeString of freshly built runtime strings. the buffers are allocated
+// untimed, as concatenation would have done
+static void benchTakeString(KeyKind kind, int size) {
+  char name[64];
+  snprintf(name, sizeof(name), "takeString/%s", keyKindNames[kind]);
+  if (!isSelected(name)) return;
+
+  char** buffers = malloc(sizeof(char*) * size);
+  int* lengths = malloc(sizeof(int) * size);
+  char buffer[256];
+
+  double runs[RUNS];
+  for (int run = 0; run < RUNS; run++) {
+    for (int i = 0; i < size; i++) {
+      lengths[i] = makeKey(buffer, kind, i, 0);
+      buffers[i] = ALLOCATE(char, lengths[i] + 1);
+      memcpy(buffers[i], buffer, lengths[i]);
+      buffers[i][lengths[i]] = '\0';
+    }
+
+    uint64_t start = metricsNow();
+    for (int i = 0; i < size; i++) takeString(buffers[i], lengths[i]);
+    runs[run] = (double)(metricsNow() - start) / size;
+    endCase();
+  }
+  report(name, size, -1, median(runs, RUNS), false);
+
+  free(buffers);
+  free(lengths);
+}
+
+static void benchHashString(int length) {
+  char name[64];
+  snprintf(name, sizeof(name), "hashString/%d", length);
+  if (!isSelected(name)) return;
+
+  char* chars = malloc(length);
+  rngState = 42;
+  randomLetters(chars, length);
+
+  int passes = MIN_OPS;
+  double runs[RUNS];
+  volatile uint32_t sink = 0;
+  for (int run = 0; run < RUNS; run++) {
+    uint64_t start = metricsNow();
+    for (int pass = 0; pass < passes; pass++) {
+      // varying one byte keeps the call from being hoisted out of the loop
+      chars[0] = (char)pass;
+      sink += hashString(chars, length);
+    }
+    runs[run] = (double)(metricsNow() - start) / passes;
+  }
+  // bytes per ns is GB/s, shown where the probe columns would be
+  double nsPerOp = median(runs, RUNS);
+  printf("%-32s %8d %5s %10.2f %10.2f GB/s\n", name, length, "", nsPerOp,
+         length / nsPerOp);
+
+  free(chars);
+}
+//---------- END STRING CASES ------------//
+
+//---------- START CHUNK CASES ------------//
+// writes size bytes into a fresh chunk, on the GC heap or in an arena
+static void benchWriteChunk(int size, bool inArena) {
+  char name[64];
+  snprintf(name, sizeof(name), "writeChunk%s", inArena ? "/arena" : "");
+  if (!isSelected(name)) return;
+
+  int passes = passesFor(size);
+  double runs[RUNS];
+  for (int run = 0; run < RUNS; run++) {
+    uint64_t start = metricsNow();
+    for (int pass = 0; pass < passes; pass++) {
+      Arena arena;
+      Chunk chunk;
+      if (inArena) {
+        initArena(&arena);
+        initChunkInArena(&chunk, &arena);
+      } else {
+        initChunk(&chunk);
+      }
+      for (int i = 0; i < size; i++) writeChunk(&chunk, (uint8_t)i, i >> 4);
+      freeChunk(&chunk);
+      if (inArena) freeArena(&arena);
+    }
+    runs[run] = (double)(metricsNow() - start) / ((double)passes * size);
+  }
+  report(name, size, -1, median(runs, RUNS), false);
+  endCase();
+}
+
+static void benchAddConstant(int size) {
+  const char* name = "addConstant";
+  if (!isSelected(name)) return;
+
+  int passes = passesFor(size);
+  double runs[RUNS];
+  for (int run = 0; run < RUNS; run++) {
+    uint64_t start = metricsNow();
+    for (int pass = 0; pass < passes; pass++) {
+      Chunk chunk;
+      initChunk(&chunk);
+      for (int i = 0; i < size; i++) addConstant(&chunk, NUMBER_VAL(i));
+      freeChunk(&chunk);
+    }
+    runs[run] = (double)(metricsNow() - start) / ((double)passes * size);
+  }
+  report(name, size, -1, median(runs, RUNS), false);
+  endCase();
+}
+//---------- END CHUNK CASES ------------//
+
+//---------- START SCANNER CASES ------------//
+#define SCANNER_SOURCE_SIZE (4 << 20)
+
+typedef enum {
+  SOURCE_MIXED,
+  SOURCE_IDENTIFIERS,
+  SOURCE_WHITESPACE,
+  SOURCE_COMMENTS,
+  SOURCE_STRINGS,
+  SOURCE_NUMBERS,
+  SOURCE_KIND_COUNT
+} SourceKind;
+
+static const char* sourceKindNames[SOURCE_KIND_COUNT] = {
+    [SOURCE_MIXED] = "mixed",           [SOURCE_IDENTIFIERS] = "identifiers",
+    [SOURCE_WHITESPACE] = "whitespace", [SOURCE_COMMENTS] = "comments",
+    [SOURCE_STRINGS] = "strings",       [SOURCE_NUMBERS] = "numbers",
+};
+
+// appends one line of the given kind, returning its length
+static int makeSourceLine(char* buffer, SourceKind kind, int i) {
+  char word[32];
+  switch (kind) {
+    case SOURCE_MIXED:
+      return sprintf(buffer,
+                     "var total%d = (count + %d.5) * 2; // running total\n"
+                     "if (total%d >= 10) print \"big\"; else print nil;\n",
+                     i, i, i);
+    case SOURCE_IDENTIFIERS:
+      randomLetters(word, 12);
+      word[12] = '\0';
+      return sprintf(buffer, "%s_%d while forEach this returnValue %s\n", word,
+                     i, word);
+    case SOURCE_WHITESPACE:
+      return sprintf(buffer, "%60s%d\n\n\t\t\t\t    \r\n", "", i);
+    case SOURCE_COMMENTS:
+      return sprintf(buffer,
+                     "x // %d lorem ipsum dolor sit amet, consectetur"
+                     " adipiscing elit, sed do eiusmod tempor incididunt\n",
+                     i);
+    case SOURCE_STRINGS:
+      randomLetters(word, 24);
+      word[24] = '\0';
+      return sprintf(buffer, "\"%s %s %s %d\nsecond line\" + \"\"\n", word,
+                     word, word, i);
+    case SOURCE_NUMBERS:
+      return sprintf(buffer, "%d + %d.%d - 3.14159 * 1000000 / %d\n", i,
+                     i * 7, i % 1000, i + 1);
+    default:
+      return 0;
+  }
+}
+
+// scans a few MB of one kind of source, token by token, without compiling
+static void benchScanner(SourceKind kind) {
+  char name[64];
+  snprintf(name, sizeof(name), "scanner/%s", sourceKindNames[kind]);
+  if (!isSelected(name)) return;
+
+  char* source = malloc(SCANNER_SOURCE_SIZE + 256);
+  int length = 0;
+  rngState = 45;
+  for (int i = 0; length < SCANNER_SOURCE_SIZE; i++) {
+    length += makeSourceLine(source + length, kind, i);
+  }
+
+  double runs[RUNS];
+  int tokens = 0;
+  for (int run = 0; run < RUNS; run++) {
+    tokens = 0;
+    uint64_t start = metricsNow();
+    initScanner(source);
+    while (scanToken().type != TOKEN_EOF) tokens++;
+    runs[run] = (double)(metricsNow() - start);
+  }
+
+  // ns/op is per token here. bytes per ns * 1000 is MB/s
+  double ns = median(runs, RUNS);
+  printf("%-32s %8d %5s %10.2f %10.1f MB/s\n", name, length, "", ns / tokens,
+         1000.0 * length / ns);
+
+  free(source);
+}
+//---------- END SCANNER CASES ------------//
+
+//---------- START NUMBER CASES ------------//
+#define LITERAL_COUNT 4096
+
+typedef enum {
+  LITERALS_INTEGERS,    // "0" to "99999"
+  LITERALS_SHORT,       // a few digits either side of the point
+  LITERALS_ROUND_TRIP,  // 17 significant digits, as %.17g prints them
+  LITERAL_KIND_COUNT
+} LiteralKind;
+
+static const char* literalKindNames[LITERAL_KIND_COUNT] = {
+    [LITERALS_INTEGERS] = "integers",
+    [LITERALS_SHORT] = "short",
+    [LITERALS_ROUND_TRIP] = "roundtrip",
+};
+
+// LITERAL_COUNT literals, 32 bytes apart and '\0'-terminated for
+// strtod(). the same kind always gives the same literals
+static char* makeLiterals(LiteralKind kind, int* lengths) {
+  char* literals = malloc(LITERAL_COUNT * 32);
+  rngState = 46;
+  for (int i = 0; i < LITERAL_COUNT; i++) {
+    char* literal = literals + i * 32;
+    switch (kind) {
+      case LITERALS_INTEGERS:
+        lengths[i] = sprintf(literal, "%d", (int)(nextRandom() % 100000));
+        break;
+      case LITERALS_SHORT:
+        lengths[i] = sprintf(literal, "%d.%d", (int)(nextRandom() % 1000),
+                             (int)(nextRandom() % 10000));
+        break;
+      default:
+        lengths[i] = sprintf(
+            literal, "0.%017llu",
+            (unsigned long long)(nextRandom() % 100000000000000000u));
+        break;
+    }
+  }
+  return literals;
+}
+
+// parses the same literals with parseNumber() and with strtod(), which
+// number() in the compiler used to call
+static void benchParseNumber(LiteralKind kind, bool isStrtod) {
+  char name[64];
+  snprintf(name, sizeof(name), "%s/%s", isStrtod ? "strtod" : "parseNumber",
+           literalKindNames[kind]);
+  if (!isSelected(name)) return;
+
+  int lengths[LITERAL_COUNT];
+  char* literals = makeLiterals(kind, lengths);
+
+  int passes = passesFor(LITERAL_COUNT);
+  double runs[RUNS];
+  volatile double sink = 0;
+  for (int run = 0; run < RUNS; run++) {
+    uint64_t start = metricsNow();
+    for (int pass = 0; pass < passes; pass++) {
+      for (int i = 0; i < LITERAL_COUNT; i++) {
+        const char* literal = literals + i * 32;
+        sink += isStrtod ? strtod(literal, NULL)
+                         : parseNumber(literal, lengths[i]);
+      }
+    }
+    runs[run] =
+        (double)(metricsNow() - start) / ((double)passes * LITERAL_COUNT);
+  }
+  report(name, LITERAL_COUNT, -1, median(runs, RUNS), false);
+
+  free(literals);
+}
+
+// formats the values of those literals with formatNumber() and with
+// snprintf("%g"), which printValue() used to call
+static void benchFormatNumber(LiteralKind kind, bool isSnprintf) {
+  char name[64];
+  snprintf(name, sizeof(name), "%s/%s",
+           isSnprintf ? "snprintf" : "formatNumber", literalKindNames[kind]);
+  if (!isSelected(name)) return;
+
+  int lengths[LITERAL_COUNT];
+  char* literals = makeLiterals(kind, lengths);
+  double values[LITERAL_COUNT];
+  for (int i = 0; i < LITERAL_COUNT; i++) {
+    values[i] = parseNumber(literals + i * 32, lengths[i]);
+  }
+
+  int passes = passesFor(LITERAL_COUNT);
+  double runs[RUNS];
+  volatile int sink = 0;
+  for (int run = 0; run < RUNS; run++) {
+    uint64_t start = metricsNow();
+    for (int pass = 0; pass < passes; pass++) {
+      for (int i = 0; i < LITERAL_COUNT; i++) {
+        char buffer[NUMBER_FORMAT_MAX];
+        sink += isSnprintf
+                    ? snprintf(buffer, sizeof(buffer), "%g", values[i])
+                    : formatNumber(values[i], buffer);
+      }
+    }
+    runs[run] =
+        (double)(metricsNow() - start) / ((double)passes * LITERAL_COUNT);
+  }
+  report(name, LITERAL_COUNT, -1, median(runs, RUNS), false);
+
+  free(literals);
+}
+//---------- END NUMBER CASES ------------//
+
+int main(int argc, const char* argv[]) {
+  if (argc > 2) {
+    fprintf(stderr, "Usage: microbench [case substring]\n");
+    return 64;
+  }
+  if (argc == 2) filter = argv[1];
+
+  initVM();
+  // nothing a case makes is rooted. endCase() collects explicitly instead
+  vm.nextGC = (size_t)-1;
+
+  printHeader();
+  for (int kind = 0; kind < KEY_KIND_COUNT; kind++) {
+    for (int s = 0; s < TABLE_SIZE_COUNT; s++) {
+      int size = tableSizes[s];
+      benchTableGet(kind, size, 100);
+      benchTableGet(kind, size, 50);
+      benchTableGet(kind, size, 0);
+      benchTableInsert(kind, size, false);
+      benchTableInsert(kind, size, true);
+      benchTableOverwrite(kind, size);
+      benchTableChurn(kind, size);
+      benchTableFindString(kind, size, 100);
+      benchTableFindString(kind, size, 0);
+    }
+  }
+
+  benchTableSetLatency(1 << 21, false);
+  benchTableSetLatency(1 << 21, true);
+
+  for (int kind = 0; kind < KEY_KIND_COUNT; kind++) {
+    for (int s = 0; s < TABLE_SIZE_COUNT; s++) {
+      benchInternProbes(kind, tableSizes[s], false);
+      benchInternProbes(kind, tableSizes[s], true);
+    }
+  }
+
+  for (int kind = 0; kind < KEY_KIND_COUNT; kind++) {
+    benchCopyString(kind, 65536, true);
+    benchCopyString(kind, 65536, false);
+    benchTakeString(kind, 65536);
+  }
+
+  const int hashLengths[] = {4, 16, 64, 256, 4096};
+  for (int i = 0; i < (int)(sizeof(hashLengths) / sizeof(int)); i++) {
+    benchHashString(hashLengths[i]);
+  }
+
+  benchWriteChunk(64, false);
+  benchWriteChunk(4096, false);
+  benchWriteChunk(64, true);
+  benchWriteChunk(4096, true);
+  benchAddConstant(256);
+
+  for (int kind = 0; kind < SOURCE_KIND_COUNT; kind++) {
+    benchScanner(kind);
+  }
+
+  for (int kind = 0; kind < LITERAL_KIND_COUNT; kind++) {
+    benchParseNumber(kind, false);
+    benchParseNumber(kind, true);
+  }
+  for (int kind = 0; kind < LITERAL_KIND_COUNT; kind++) {
+    benchFormatNumber(kind, false);
+    benchFormatNumber(kind, true);
+  }
+
+  freeVM();
+  return 0;
+}
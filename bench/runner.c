@@ -0,0 +1,49 @@
+// runs a command and prints "<seconds> <peak RSS KiB> <exit status>" to
+// stderr. the command's own stdout and stderr go to /dev/null.
+//
+// the harness can't measure this itself: on Linux a child's ru_maxrss
+// includes the RSS it had before exec, i.e. the Python interpreter's. this
+// process is small, so the floor it adds is too.
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: runner command [args...]\n");
+    return 64;
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  pid_t pid = fork();
+  if (pid < 0) return 71;
+  if (pid == 0) {
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    dup2(devNull, STDERR_FILENO);
+    execv(argv[1], argv + 1);
+    _exit(127);
+  }
+
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) < 0) return 71;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double seconds =
+      (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  long rss = usage.ru_maxrss;
+#ifdef __APPLE__
+  // bytes on macOS
+  rss /= 1024;
+#endif
+  int exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+  fprintf(stderr, "%.9f %ld %d\n", seconds, rss, exitCode);
+  return 0;
+}
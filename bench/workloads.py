@@ -0,0 +1,124 @@
+"""Lox benchmark workloads.
+
+Each workload is generated deterministically and fed to clox either as a
+file (one chunk) or on stdin (one chunk per REPL line). A chunk is a single
+expression with at most 256 constants, so workloads that need volume are
+spread over many REPL lines.
+"""
+
+import random
+
+# (mode, source) pairs are produced by the functions registered below
+WORKLOADS = {}
+
+def workload(mode):
+    def register(generate):
+        WORKLOADS[generate.__name__] = (mode, generate)
+        return generate
+
+    return register
+
+
+def lines(count, make_line):
+    return "\n".join(make_line(i) for i in range(count)) + "\n"
+
+
+@workload("repl")
+def arith():
+    """Number-heavy expressions: binary ops, unary ops and numeric natives."""
+
+    def make_line(i):
+        return (
+            f"sqrt({i % 97 + 16}) * 3 - {i % 13} / 5 + 6 * (7 - {i % 11}) "
+            f"+ floor({i}.5) * 10 - -11 / 12 + abs(-{i % 7}) * ceil(1.25) "
+            f"- ({i} + 1) * (2 - {i % 5}) / (3 + {i % 3}) > 0 == !false"
+        )
+
+    return lines(20000, make_line)
+
+
+@workload("repl")
+def nesting():
+    """Deeply nested groupings and unary chains (compiler recursion)."""
+
+    def make_line(i):
+        depth = 60 + i % 20
+        grouped = "(" * depth + "1" + "".join(
+            f" {'+-*'[d % 3]} {d % 9 + 1})" for d in range(depth)
+        )
+        return "-" * 80 + grouped
+
+    return lines(5000, make_line)
+
+
+@workload("repl")
+def concat():
+    """Long string concatenation chains of distinct literals (OP_CONCAT_N)."""
+
+    def make_line(i):
+        return " + ".join(f'"s{i}_{j}"' for j in range(40))
+
+    return lines(10000, make_line)
+
+
+@workload("repl")
+def literals():
+    """Concatenations of long literals, a third of them repeated, around
+    the default interning cutoff (INTERN_MAX_LENGTH)."""
+    rng = random.Random(44)
+    shared = [
+        "".join(rng.choice("abcdefghij") for _ in range(rng.randint(40, 120)))
+        for _ in range(32)
+    ]
+
+    def make_line(i):
+        parts = []
+        for j in range(30):
+            if j % 3 == 0:
+                parts.append(f'"{rng.choice(shared)}"')
+            else:
+                length = rng.randint(40, 160)
+                parts.append(f'"{i}_{j}_' + "x" * length + '"')
+        return " + ".join(parts)
+
+    return lines(4000, make_line)
+
+
+@workload("repl")
+def intern():
+    """Duplicate short literals: interning hits on every literal."""
+    words = ["alpha", "beta", "gamma", "delta", "eps", "zeta", "eta", "theta"]
+    rng = random.Random(43)
+
+    def make_line(i):
+        parts = [f'"{rng.choice(words)}"' for _ in range(60)]
+        return " + ".join(parts)
+
+    return lines(10000, make_line)
+
+
+@workload("repl")
+def constants():
+    """Constant pools of 150 distinct numbers per chunk."""
+
+    def make_line(i):
+        return " + ".join(str((i * 150 + j) % 1000) for j in range(150))
+
+    return lines(3000, make_line)
+
+
+@workload("file")
+def scanner():
+    """One large source file: comments, whitespace and long strings."""
+    rng = random.Random(45)
+    comment = "// " + "lorem ipsum dolor sit amet " * 3 + "\n"
+    parts = []
+    for i in range(200):
+        parts.append(comment * 200)
+        if i % 4 == 0:
+            body = "".join(rng.choice("abcdefgh \t") for _ in range(20000))
+            parts.append(f'"{body}" +\n')
+        else:
+            parts.append(f'    "s{i}" +\n')
+    parts.append('"end"\n')
+    return "".join(parts)
@@ -2,24 +2,36 @@
 
 #include <stdlib.h>
 
+#include "arena.h"
 #include "memory.h"
+#include "object.h"
 #include "value.h"
+#include "vm.h"
 
 void initChunk(Chunk *chunk) {
   chunk->count = 0;
   chunk->capacity = 0;
   chunk->code = NULL;
   chunk->lines = NULL;
+  chunk->source = NULL;
+  chunk->arena = NULL;
   initValueArray(&chunk->constants);
 }
 
+void initChunkInArena(Chunk *chunk, Arena *arena) {
+  initChunk(chunk);
+  chunk->arena = arena;
+  chunk->constants.arena = arena;
+}
+
 void writeChunk(Chunk *chunk, uint8_t byte, int line) {
   if (chunk->capacity < chunk->count + 1) {
     int oldCapacity = chunk->capacity;
     chunk->capacity = GROW_CAPACITY(oldCapacity);
-    chunk->code =
-        GROW_ARRAY(uint8_t, chunk->code, oldCapacity, chunk->capacity);
-    chunk->lines = GROW_ARRAY(int, chunk->lines, oldCapacity, chunk->capacity);
+    chunk->code = ARENA_GROW_ARRAY(chunk->arena, uint8_t, chunk->code,
+                                   oldCapacity, chunk->capacity);
+    chunk->lines = ARENA_GROW_ARRAY(chunk->arena, int, chunk->lines,
+                                    oldCapacity, chunk->capacity);
   }
 
   chunk->code[chunk->count] = byte;
@@ -28,12 +40,46 @@ void writeChunk(Chunk *chunk, uint8_t byte, int line) {
 }
 
 int addConstant(Chunk *chunk, Value value) {
+  // growing the array may collect: keep the value reachable until it's in
+  push(value);
   writeValueArray(&chunk->constants, value);
+  pop();
   return chunk->constants.count - 1;
 }
 
+// objects never hold borrowed literals and there are no globals, so a
+// literal outlives its chunk only as a value left on the stack
+static bool isOnStack(ObjString* string) {
+  for (Value* slot = vm.stack; slot < vm.stackTop; slot++) {
+    if (IS_OBJ(*slot) && AS_OBJ(*slot) == (Obj*)string) return true;
+  }
+  return false;
+}
+
 void freeChunk(Chunk *chunk) {
-  FREE_ARRAY(uint8_t, chunk->code, chunk->capacity);
+  // borrowed literals only get chars of their own if something still
+  // reaches them. vm.strings holds its keys weakly, so it doesn't count:
+  // the others leave it, and the sweep frees them without reading chars
+  for (int i = 0; i < chunk->constants.count; i++) {
+    Value constant = chunk->constants.values[i];
+    if (!IS_STRING(constant)) continue;
+
+    ObjString* string = AS_STRING(constant);
+    if (string->storage != STRING_BORROWED) continue;
+
+    if (isOnStack(string)) {
+      promoteString(string);
+    } else {
+      if (string->isInterned) {
+        tableDelete(&vm.strings, string);
+        string->isInterned = false;
+      }
+      detachString(string);
+    }
+  }
+
+  ARENA_FREE_ARRAY(chunk->arena, uint8_t, chunk->code, chunk->capacity);
+  ARENA_FREE_ARRAY(chunk->arena, int, chunk->lines, chunk->capacity);
   freeValueArray(&chunk->constants);
   initChunk(chunk);
 }
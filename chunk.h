@@ -18,18 +18,29 @@ typedef enum {
   OP_NOT,
   OP_EQUAL,
   OP_GREATER,
-  OP_LESS
+  OP_LESS,
+  OP_CALL,
+  OP_CONCAT_N
 } OpCode;
 
+#define OP_COUNT (OP_CONCAT_N + 1)
+
 typedef struct {
   int count;
   int capacity;
   uint8_t *code;
   int *lines;
   ValueArray constants;
+  // owner of code, lines and constants, or NULL for the GC heap
+  Arena *arena;
+  // buffer the chunk was compiled from. string literals borrow their chars
+  // from it, so it must stay alive until the chunk is freed
+  const char *source;
 } Chunk;
 
 void initChunk(Chunk *chunk);
+// the chunk's arrays are allocated from arena and released with it
+void initChunkInArena(Chunk *chunk, Arena *arena);
 void writeChunk(Chunk *chunk, uint8_t byte, int line);
 int addConstant(Chunk *chunk, Value value);
 void freeChunk(Chunk *chunk);
@@ -5,7 +5,24 @@
 #include <stddef.h>
 #include <stdint.h>
 
+// release is the default build. build with -DCLOX_DEBUG for the debug
+// configuration, which disassembles every compiled chunk and starts with
+// tracing set as if by --trace=verbose
+#ifdef CLOX_DEBUG
 #define DEBUG_PRINT_CODE
 #define DEBUG_TRACE_EXECUTION
+#endif
+
+// heap objects and small buffers come from the size-class pools in pool.c.
+// build with -DUSE_SYSTEM_MALLOC to compare against plain malloc
+#ifndef USE_SYSTEM_MALLOC
+#define USE_POOL_ALLOCATOR
+#endif
+
+// build with -DPROFILE_OPCODES to count and time every executed opcode
+// (see profile.h). without it the profiler is not compiled at all
+
+// build with -DDEBUG_STRESS_GC to collect garbage on every allocation
+// build with -DDEBUG_LOG_GC to log each collection
 
 #endif
@@ -2,10 +2,15 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "chunk.h"
 #include "common.h"
+#include "lexer.h"
+#include "memory.h"
+#include "number.h"
 #include "object.h"
+#include "output.h"
 #include "scanner.h"
 #include "vm.h"
 
@@ -44,12 +49,15 @@ typedef struct {
 
 Parser parser;
 Chunk* compilingChunk;
+// tokens scanned ahead on another thread, or NULL to call scanToken()
+static TokenStream* tokenStream = NULL;
 
 //---------- START ERROR UTILS ------------//
 static void errorAt(Token* token, const char* message) {
   if (parser.panicMode) return;
   parser.panicMode = true;
 
+  flushOutputBeforeError();
   fprintf(stderr, "[Line %d] Error ", token->line);
 
   if (token->type == TOKEN_EOF) {
@@ -76,7 +84,22 @@ static void advance() {
   parser.previous = parser.current;
 
   for (;;) {
-    parser.current = scanToken();
+    if (tokenStream != NULL) {
+      // scan time is spent on the producer thread, off this one's clock
+      METRIC_INC(METRIC_TOKENS);
+      parser.current = readToken(tokenStream);
+    } else if ((METRIC_INC(METRIC_TOKENS) & (SCAN_TIMING_INTERVAL - 1)) ==
+               0) {
+      uint64_t start = metricsNow();
+      parser.current = scanToken();
+      uint64_t elapsed = metricsNow() - start;
+      if (elapsed > vm.metrics.clockOverheadNs) {
+        vm.metrics.scanNs +=
+            (elapsed - vm.metrics.clockOverheadNs) * SCAN_TIMING_INTERVAL;
+      }
+    } else {
+      parser.current = scanToken();
+    }
     if (parser.current.type != TOKEN_ERROR) break;
 
     errorAtCurrent(parser.current.start);
@@ -92,6 +115,14 @@ static void consume(TokenType type, const char* message) {
   errorAtCurrent(message);
 }
 
+static bool check(TokenType type) { return parser.current.type == type; }
+
+static bool match(TokenType type) {
+  if (!check(type)) return false;
+  advance();
+  return true;
+}
+
 static Chunk* currentChunk() { return compilingChunk; }
 
 static void emitByte(uint8_t byte) {
@@ -127,6 +158,7 @@ static void parsePrecedence(Precedence precedence) {
   ParseFn prefixRule = getRule(parser.previous.type)->prefix;
   if (prefixRule == NULL) {
     error("Expect expression.");
+    return;
   }
   prefixRule();
 
@@ -138,6 +170,28 @@ static void parsePrecedence(Precedence precedence) {
   }
 }
 
+// a + b + c + ... is emitted as a single OP_CONCAT_N so that string chains
+// are built in one allocation. called with the first 2 operands emitted.
+static void addChain() {
+  int operandCount = 2;
+
+  while (match(TOKEN_PLUS)) {
+    if (operandCount == UINT8_MAX) {
+      // flush: the partial result becomes the 1st operand of the next op
+      emitBytes(OP_CONCAT_N, (uint8_t)operandCount);
+      operandCount = 1;
+    }
+    parsePrecedence(PREC_TERM + 1);
+    operandCount++;
+  }
+
+  if (operandCount == 2) {
+    emitByte(OP_ADD);
+  } else {
+    emitBytes(OP_CONCAT_N, (uint8_t)operandCount);
+  }
+}
+
 static void binary() {
   TokenType operatorType = parser.previous.type;
 
@@ -147,7 +201,7 @@ static void binary() {
 
   switch (operatorType) {
     case TOKEN_PLUS:
-      emitByte(OP_ADD);
+      addChain();
       break;
     case TOKEN_MINUS:
       emitByte(OP_SUBTRACT);
@@ -220,14 +274,51 @@ static void emitConstant(Value value) {
 }
 
 static void number() {
-  double value = strtod(parser.previous.start, NULL);
+  double value = parseNumber(parser.previous.start, parser.previous.length);
   emitConstant(NUMBER_VAL(value));
 }
 
 static void string() {
-  // strip the quotes at the start & end
+  // strip the quotes at the start & end. the chars stay in the source
+  // buffer, which the chunk keeps alive
   emitConstant(OBJ_VAL(
-      copyString(parser.previous.start + 1, parser.previous.length - 2)));
+      borrowString(parser.previous.start + 1, parser.previous.length - 2)));
+}
+
+static void variable() {
+  // the only names in scope are natives, which are resolved at compile time
+  ObjString* name =
+      internString(parser.previous.start, parser.previous.length);
+
+  Value native;
+  if (!tableGet(&vm.natives, name, &native)) {
+    error("Undefined function.");
+    return;
+  }
+
+  emitConstant(native);
+}
+
+static uint8_t argumentList() {
+  uint8_t argCount = 0;
+
+  if (!check(TOKEN_RIGHT_PAREN)) {
+    do {
+      expression();
+      if (argCount == UINT8_MAX) {
+        error("Can't have more than 255 arguments.");
+      }
+      argCount++;
+    } while (match(TOKEN_COMMA));
+  }
+
+  consume(TOKEN_RIGHT_PAREN, "Expect ')' after arguments.");
+  return argCount;
+}
+
+static void call() {
+  uint8_t argCount = argumentList();
+  emitBytes(OP_CALL, argCount);
 }
 
 static void grouping() {
@@ -255,7 +346,7 @@ static void unary() {
 }
 
 ParseRule rules[] = {
-    [TOKEN_LEFT_PAREN] = {grouping, NULL, PREC_NONE},
+    [TOKEN_LEFT_PAREN] = {grouping, call, PREC_CALL},
     [TOKEN_RIGHT_PAREN] = {NULL, NULL, PREC_NONE},
     [TOKEN_LEFT_BRACE] = {NULL, NULL, PREC_NONE},
     [TOKEN_RIGHT_BRACE] = {NULL, NULL, PREC_NONE},
@@ -274,7 +365,7 @@ ParseRule rules[] = {
     [TOKEN_GREATER_EQUAL] = {NULL, binary, PREC_COMPARISON},
     [TOKEN_LESS] = {NULL, binary, PREC_COMPARISON},
     [TOKEN_LESS_EQUAL] = {NULL, binary, PREC_COMPARISON},
-    [TOKEN_IDENTIFIER] = {NULL, NULL, PREC_NONE},
+    [TOKEN_IDENTIFIER] = {variable, NULL, PREC_NONE},
     [TOKEN_STRING] = {string, NULL, PREC_NONE},
     [TOKEN_NUMBER] = {number, NULL, PREC_NONE},
     [TOKEN_AND] = {NULL, NULL, PREC_NONE},
@@ -300,9 +391,22 @@ ParseRule rules[] = {
 static ParseRule* getRule(TokenType type) { return &rules[type]; }
 //---------- END PARSING UTILS -----------//
 
+static void stopLexThread() {
+  if (tokenStream == NULL) return;
+  stopTokenStream(tokenStream);
+  tokenStream = NULL;
+}
+
 bool compile(const char* source, Chunk* chunk) {
-  initScanner(source);
+  if (vm.lexThreadMinLength != 0) {
+    size_t length = strlen(source);
+    if (length >= vm.lexThreadMinLength) {
+      tokenStream = startTokenStream(source, length);
+    }
+  }
+  if (tokenStream == NULL) initScanner(source);
   compilingChunk = chunk;
+  compilingChunk->source = source;
 
   // reset all error flags
   parser.hadError = false;
@@ -311,9 +415,30 @@ bool compile(const char* source, Chunk* chunk) {
   advance();
   expression();
   consume(TOKEN_EOF, "Expect end of expression.");
+  stopLexThread();
 
   endCompile();
+  METRIC_ADD(METRIC_CONSTANTS, chunk->constants.count);
+  if ((uint64_t)chunk->constants.count > getMetric(METRIC_MAX_CONSTANTS)) {
+    vm.metrics.counters[METRIC_MAX_CONSTANTS] = chunk->constants.count;
+  }
+  compilingChunk = NULL;
 
   // false when parse error occurs
   return !parser.hadError;
 }
+
+void markCompilerRoots() {
+  // constants emitted so far. interpret() roots the chunk as well, but
+  // compile() may be called on its own
+  if (compilingChunk != NULL) {
+    for (int i = 0; i < compilingChunk->constants.count; i++) {
+      markValue(compilingChunk->constants.values[i]);
+    }
+  }
+}
+
+void abortCompile() {
+  stopLexThread();
+  compilingChunk = NULL;
+}
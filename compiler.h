@@ -5,5 +5,9 @@
 #include "stdlib.h"
 
 bool compile(const char* source, Chunk* chunk);
+void markCompilerRoots();
+// forgets the chunk being compiled after an out-of-memory unwind, and
+// stops the lexer thread if there is one
+void abortCompile();
 
 #endif
@@ -1,76 +1,114 @@
 #include "debug.h"
 
-#include <stdio.h>
+#include "output.h"
 
 void disassembleChunk(Chunk *chunk, const char *name) {
-  printf("== %s ==\n", name);
+  writeOutputf("== %s ==\n", name);
 
   for (int offset = 0; offset < chunk->count;) {
     offset = disassembleInstruction(chunk, offset);
   }
 }
 
+const char *opcodeName(uint8_t instruction) {
+  switch (instruction) {
+    case OP_CONSTANT:
+      return "OP_CONSTANT";
+    case OP_NIL:
+      return "OP_NIL";
+    case OP_TRUE:
+      return "OP_TRUE";
+    case OP_FALSE:
+      return "OP_FALSE";
+    case OP_NOT:
+      return "OP_NOT";
+    case OP_EQUAL:
+      return "OP_EQUAL";
+    case OP_GREATER:
+      return "OP_GREATER";
+    case OP_LESS:
+      return "OP_LESS";
+    case OP_NEGATE:
+      return "OP_NEGATE";
+    case OP_ADD:
+      return "OP_ADD";
+    case OP_SUBTRACT:
+      return "OP_SUBTRACT";
+    case OP_MULTIPLY:
+      return "OP_MULTIPLY";
+    case OP_DIVIDE:
+      return "OP_DIVIDE";
+    case OP_RETURN:
+      return "OP_RETURN";
+    case OP_CALL:
+      return "OP_CALL";
+    case OP_CONCAT_N:
+      return "OP_CONCAT_N";
+  }
+  return NULL;
+}
+
+int instructionLength(uint8_t instruction) {
+  switch (instruction) {
+    case OP_CONSTANT:
+    case OP_CALL:
+    case OP_CONCAT_N:
+      return 2;
+    default:
+      return 1;
+  }
+}
+
 static int constantInstruction(const char *name, Chunk *chunk, int offset) {
   // constant is the byte after opCode
   uint8_t constantIndex = chunk->code[offset + 1];
-  printf("%-16s %4d '", name, constantIndex);
+  writeOutputf("%-16s %4d '", name, constantIndex);
 
   // look up constant value in the constants pool
   Value constantValue = chunk->constants.values[constantIndex];
   printValue(constantValue);
 
-  printf("\n");
+  writeOutput("\n", 1);
+  return offset + 2;
+}
+
+static int byteInstruction(const char *name, Chunk *chunk, int offset) {
+  // operand is the byte after opCode, e.g. an argument count
+  uint8_t operand = chunk->code[offset + 1];
+  writeOutputf("%-16s %4d\n", name, operand);
   return offset + 2;
 }
 
 static int simpleInstruction(const char *name, int offset) {
-  printf("%s\n", name);
+  writeOutputf("%s\n", name);
   return offset + 1;
 }
 
 int disassembleInstruction(Chunk *chunk, int offset) {
-  printf("%04d ", offset);
+  writeOutputf("%04d ", offset);
 
   // Line numbers are omitted if same as previous byte in the chunk
   if (offset > 0 && chunk->lines[offset] == chunk->lines[offset - 1]) {
-    printf("   | ");
+    writeOutputString("   | ");
   } else {
-    printf("%04d ", chunk->lines[offset]);
+    writeOutputf("%04d ", chunk->lines[offset]);
   }
 
   uint8_t instruction = chunk->code[offset];
 
+  const char *name = opcodeName(instruction);
+  if (name == NULL) {
+    writeOutputf("Unknown opcode: %d\n", instruction);
+    return offset + 1;
+  }
+
   switch (instruction) {
     case OP_CONSTANT:
-      return constantInstruction("OP_CONSTANT", chunk, offset);
-    case OP_NIL:
-      return simpleInstruction("OP_NIL", offset);
-    case OP_TRUE:
-      return simpleInstruction("OP_TRUE", offset);
-    case OP_FALSE:
-      return simpleInstruction("OP_FALSE", offset);
-    case OP_NOT:
-      return simpleInstruction("OP_NOT", offset);
-    case OP_EQUAL:
-      return simpleInstruction("OP_EQUAL", offset);
-    case OP_GREATER:
-      return simpleInstruction("OP_GREATER", offset);
-    case OP_LESS:
-      return simpleInstruction("OP_LESS", offset);
-    case OP_NEGATE:
-      return simpleInstruction("OP_NEGATE", offset);
-    case OP_ADD:
-      return simpleInstruction("OP_ADD", offset);
-    case OP_SUBTRACT:
-      return simpleInstruction("OP_SUBTRACT", offset);
-    case OP_MULTIPLY:
-      return simpleInstruction("OP_MULTIPLY", offset);
-    case OP_DIVIDE:
-      return simpleInstruction("OP_DIVIDE", offset);
-    case OP_RETURN:
-      return simpleInstruction("OP_RETURN", offset);
+      return constantInstruction(name, chunk, offset);
+    case OP_CALL:
+    case OP_CONCAT_N:
+      return byteInstruction(name, chunk, offset);
     default:
-      printf("Unknown opcode: %d", instruction);
-      return offset + 1;
+      return simpleInstruction(name, offset);
   }
 }
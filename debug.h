@@ -5,5 +5,9 @@
 
 void disassembleChunk(Chunk *chunk, const char *name);
 int disassembleInstruction(Chunk *chunk, int offset);
+// NULL for bytes that are not an opcode
+const char *opcodeName(uint8_t instruction);
+// the opcode plus its operand bytes
+int instructionLength(uint8_t instruction);
 
 #endif
@@ -0,0 +1,284 @@
+#include "heap.h"
+
+#include "arena.h"
+#include "memory.h"
+#include "pool.h"
+#include "table.h"
+#include "vm.h"
+
+// string contents in a snapshot are cut to this many chars
+#define SNAPSHOT_PREVIEW_LENGTH 64
+
+const char* objTypeName(ObjType type) {
+  switch (type) {
+    case OBJ_STRING:
+      return "string";
+    case OBJ_NATIVE:
+      return "native";
+  }
+  return "unknown";
+}
+
+static void getTableStats(Table* table, HeapTableStats* stats) {
+  stats->count = table->count;
+  stats->capacity = table->capacity;
+  stats->bytes = tableBytes(table);
+  stats->loadFactor =
+      table->capacity == 0 ? 0.0 : (double)table->count / table->capacity;
+}
+
+static void addStringStats(ObjString* string, HeapStats* stats) {
+  if (string->isInterned) stats->internedStrings++;
+
+  switch (string->storage) {
+    case STRING_BORROWED:
+      stats->borrowedCharBytes += string->length;
+      break;
+    case STRING_DETACHED:
+      // the chars went with the source
+      break;
+    default:
+      stats->stringCharBytes += string->length + 1;
+      break;
+  }
+}
+
+// what recordChunkStats() saw of the last chunk. only the chunk rows are used
+static HeapStats lastChunkStats;
+
+static void getChunkStats(Chunk* chunk, HeapStats* stats) {
+  stats->chunkCodeBytes = (size_t)chunk->capacity * sizeof(uint8_t);
+  stats->chunkLineBytes = (size_t)chunk->capacity * sizeof(int);
+  stats->chunkConstantBytes =
+      (size_t)chunk->constants.capacity * sizeof(Value);
+  if (chunk->arena != NULL) {
+    stats->chunkArenaBytes = chunk->arena->bytesAllocated;
+  }
+}
+
+void recordChunkStats(Chunk* chunk) {
+  lastChunkStats = (HeapStats){0};
+  getChunkStats(chunk, &lastChunkStats);
+}
+
+void getHeapStats(HeapStats* stats) {
+  *stats = (HeapStats){0};
+  stats->bytesAllocated = vm.bytesAllocated;
+  stats->peakBytesAllocated = vm.peakBytesAllocated;
+
+  for (Obj* object = vm.objects; object != NULL; object = object->next) {
+    stats->objects[object->type].count++;
+    stats->objects[object->type].bytes += objectSize(object);
+    if (object->type == OBJ_STRING) {
+      addStringStats((ObjString*)object, stats);
+    }
+  }
+
+  if (vm.chunk != NULL) {
+    getChunkStats(vm.chunk, stats);
+  } else {
+    stats->chunkCodeBytes = lastChunkStats.chunkCodeBytes;
+    stats->chunkLineBytes = lastChunkStats.chunkLineBytes;
+    stats->chunkConstantBytes = lastChunkStats.chunkConstantBytes;
+    stats->chunkArenaBytes = lastChunkStats.chunkArenaBytes;
+  }
+
+  getTableStats(&vm.strings, &stats->strings);
+  getTableStats(&vm.natives, &stats->natives);
+}
+
+void printHeapStats(FILE* out) {
+  HeapStats stats;
+  getHeapStats(&stats);
+
+  fprintf(out, "heap bytes %zu, peak %zu\n", stats.bytesAllocated,
+          stats.peakBytesAllocated);
+
+  fprintf(out, "%-8s %10s %12s\n", "type", "objects", "bytes");
+  for (int type = 0; type < OBJ_TYPE_COUNT; type++) {
+    fprintf(out, "%-8s %10zu %12zu\n", objTypeName((ObjType)type),
+            stats.objects[type].count, stats.objects[type].bytes);
+  }
+  fprintf(out, "string chars %zu (borrowed %zu), interned strings %zu\n",
+          stats.stringCharBytes, stats.borrowedCharBytes,
+          stats.internedStrings);
+
+  fprintf(out, "chunk code %zu, lines %zu, constants %zu, arena %zu\n",
+          stats.chunkCodeBytes, stats.chunkLineBytes,
+          stats.chunkConstantBytes, stats.chunkArenaBytes);
+
+  fprintf(out, "%-8s %10s %10s %12s %6s\n", "table", "count", "capacity",
+          "bytes", "load");
+  fprintf(out, "%-8s %10d %10d %12zu %6.2f\n", "strings", stats.strings.count,
+          stats.strings.capacity, stats.strings.bytes,
+          stats.strings.loadFactor);
+  fprintf(out, "%-8s %10d %10d %12zu %6.2f\n", "natives", stats.natives.count,
+          stats.natives.capacity, stats.natives.bytes,
+          stats.natives.loadFactor);
+
+#ifdef USE_POOL_ALLOCATOR
+  printPoolStats(out);
+#endif
+}
+
+//---------- START SNAPSHOT ------------//
+static void writeJsonString(FILE* out, const char* chars, int length) {
+  fputc('"', out);
+  for (int i = 0; i < length; i++) {
+    unsigned char c = (unsigned char)chars[i];
+    if (c == '"' || c == '\\') {
+      fprintf(out, "\\%c", c);
+    } else if (c < 0x20) {
+      // JSON text is UTF-8: every other byte goes through as is
+      fprintf(out, "\\u%04x", c);
+    } else {
+      fputc(c, out);
+    }
+  }
+  fputc('"', out);
+}
+
+static const char* storageName(StringStorage storage) {
+  switch (storage) {
+    case STRING_INLINE:
+      return "inline";
+    case STRING_BORROWED:
+      return "borrowed";
+    case STRING_PROMOTED:
+      return "promoted";
+    case STRING_DETACHED:
+      return "detached";
+  }
+  return "unknown";
+}
+
+static void writeTableStats(FILE* out, const char* name,
+                            HeapTableStats* stats) {
+  fprintf(out,
+          "\"%s\":{\"count\":%d,\"capacity\":%d,\"bytes\":%zu,"
+          "\"loadFactor\":%.4f}",
+          name, stats->count, stats->capacity, stats->bytes,
+          stats->loadFactor);
+}
+
+#ifdef USE_POOL_ALLOCATOR
+// only the size classes that have slabs, as in printPoolStats()
+static void writePoolStats(FILE* out) {
+  fprintf(out, "\"pool\":{\"slabSize\":%d,\"classes\":[", POOL_SLAB_SIZE);
+  bool isFirst = true;
+  for (int i = 0; i < POOL_CLASS_COUNT; i++) {
+    PoolClassStats stats;
+    getPoolClassStats(i, &stats);
+    if (stats.slabCount == 0) continue;
+
+    fprintf(out,
+            "%s{\"blockSize\":%zu,\"slabs\":%d,\"blocksInUse\":%zu,"
+            "\"blockCapacity\":%zu}",
+            isFirst ? "" : ",", stats.blockSize, stats.slabCount,
+            stats.blocksInUse, stats.blockCapacity);
+    isFirst = false;
+  }
+  fputs("]}", out);
+}
+#endif
+
+static void writeStats(FILE* out, HeapStats* stats) {
+  fprintf(out, "\"stats\":{\"bytesAllocated\":%zu,\"peakBytesAllocated\":%zu,",
+          stats->bytesAllocated, stats->peakBytesAllocated);
+
+  fputs("\"objects\":{", out);
+  for (int type = 0; type < OBJ_TYPE_COUNT; type++) {
+    fprintf(out, "%s\"%s\":{\"count\":%zu,\"bytes\":%zu}", type > 0 ? "," : "",
+            objTypeName((ObjType)type), stats->objects[type].count,
+            stats->objects[type].bytes);
+  }
+  fputs("},", out);
+
+  fprintf(out,
+          "\"stringCharBytes\":%zu,\"borrowedCharBytes\":%zu,"
+          "\"internedStrings\":%zu,",
+          stats->stringCharBytes, stats->borrowedCharBytes,
+          stats->internedStrings);
+  fprintf(out,
+          "\"chunk\":{\"codeBytes\":%zu,\"lineBytes\":%zu,"
+          "\"constantBytes\":%zu,\"arenaBytes\":%zu},",
+          stats->chunkCodeBytes, stats->chunkLineBytes,
+          stats->chunkConstantBytes, stats->chunkArenaBytes);
+
+  fputs("\"tables\":{", out);
+  writeTableStats(out, "strings", &stats->strings);
+  fputc(',', out);
+  writeTableStats(out, "natives", &stats->natives);
+  fputc('}', out);
+
+#ifdef USE_POOL_ALLOCATOR
+  fputc(',', out);
+  writePoolStats(out);
+#endif
+  fputc('}', out);
+}
+
+static void writeObject(FILE* out, Obj* object) {
+  fprintf(out, "{\"id\":\"%p\",\"type\":\"%s\",\"bytes\":%zu,",
+          (void*)object, objTypeName(object->type), objectSize(object));
+
+  switch (object->type) {
+    case OBJ_STRING: {
+      ObjString* string = (ObjString*)object;
+      int previewLength = string->length < SNAPSHOT_PREVIEW_LENGTH
+                              ? string->length
+                              : SNAPSHOT_PREVIEW_LENGTH;
+      // don't cut a UTF-8 sequence in two
+      while (string->storage != STRING_DETACHED &&
+             previewLength < string->length && previewLength > 0 &&
+             ((unsigned char)string->chars[previewLength] & 0xC0) == 0x80) {
+        previewLength--;
+      }
+      fprintf(out, "\"length\":%d,\"storage\":\"%s\",\"interned\":%s,",
+              string->length, storageName(string->storage),
+              string->isInterned ? "true" : "false");
+      fputs("\"preview\":", out);
+      if (string->storage == STRING_DETACHED) {
+        fputs("null", out);
+      } else {
+        writeJsonString(out, string->chars, previewLength);
+      }
+      break;
+    }
+    case OBJ_NATIVE: {
+      ObjNative* native = (ObjNative*)object;
+      fprintf(out, "\"arity\":%d,\"name\":\"%p\"", native->arity,
+              (void*)native->name);
+      break;
+    }
+  }
+
+  fputc('}', out);
+}
+
+void writeHeapSnapshot(FILE* out) {
+  HeapStats stats;
+  getHeapStats(&stats);
+
+  fputc('{', out);
+  writeStats(out, &stats);
+
+  fputs(",\n\"objects\":[", out);
+  for (Obj* object = vm.objects; object != NULL; object = object->next) {
+    fputs(object == vm.objects ? "\n" : ",\n", out);
+    writeObject(out, object);
+  }
+  fputs("],\n", out);
+
+  // the intern table only references objects listed above
+  fputs("\"strings\":[", out);
+  int cursor = 0;
+  bool isFirst = true;
+  Entry* entry;
+  while ((entry = tableNextEntry(&vm.strings, &cursor)) != NULL) {
+    fprintf(out, "%s\"%p\"", isFirst ? "" : ",", (void*)entry->key);
+    isFirst = false;
+  }
+  fputs("]}\n", out);
+}
+//---------- END SNAPSHOT ------------//
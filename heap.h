@@ -0,0 +1,63 @@
+#ifndef clox_heap_h
+#define clox_heap_h
+
+#include <stdio.h>
+
+#include "chunk.h"
+#include "common.h"
+#include "object.h"
+
+// heap accounting for diagnostics. nothing is counted on the allocation
+// path: each call walks vm.objects and the VM's tables, so it costs time
+// proportional to the heap and nothing at all when unused.
+
+typedef struct {
+  size_t count;
+  size_t bytes;
+} HeapObjectStats;
+
+typedef struct {
+  int count;
+  int capacity;
+  size_t bytes;
+  // live entries per slot
+  double loadFactor;
+} HeapTableStats;
+
+typedef struct {
+  // maintained by reallocate()
+  size_t bytesAllocated;
+  size_t peakBytesAllocated;
+
+  HeapObjectStats objects[OBJ_TYPE_COUNT];
+  // heap bytes holding string chars. borrowed chars live in the source
+  // buffer and are counted in borrowedCharBytes instead
+  size_t stringCharBytes;
+  size_t borrowedCharBytes;
+  size_t internedStrings;
+
+  // the chunk being compiled or run or, between interpret() calls, the last
+  // one interpret() ran
+  size_t chunkCodeBytes;
+  size_t chunkLineBytes;
+  size_t chunkConstantBytes;
+  // arena blocks backing the three arrays above
+  size_t chunkArenaBytes;
+
+  HeapTableStats strings;
+  HeapTableStats natives;
+} HeapStats;
+
+const char* objTypeName(ObjType type);
+
+void getHeapStats(HeapStats* stats);
+// keeps the chunk rows of the stats above for after the chunk is freed
+void recordChunkStats(Chunk* chunk);
+// with the pool allocator, followed by its slab use per size class
+void printHeapStats(FILE* out);
+// one JSON document with the stats above (and the pool's size classes),
+// every object in vm.objects and the keys of vm.strings. objects are
+// identified by address
+void writeHeapSnapshot(FILE* out);
+
+#endif
@@ -0,0 +1,175 @@
+// sigset_t and pthread_sigmask()
+#define _POSIX_C_SOURCE 200809L
+
+#include "lexer.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define RING_MASK (TOKEN_RING_SIZE - 1)
+// busy-waits before each side gives up its core with sched_yield()
+#define SPIN_LIMIT 64
+
+// Token minus the pointer: 16 bytes instead of 24
+typedef struct {
+  // into the source. unused by TOKEN_ERROR, whose message is kept in
+  // errorMessages at the same slot
+  uint32_t offset;
+  uint32_t length;
+  uint32_t line;
+  uint8_t type;
+} PackedToken;
+
+struct TokenStream {
+  const char* source;
+  PackedToken ring[TOKEN_RING_SIZE];
+  // written only for TOKEN_ERROR slots
+  const char* errorMessages[TOKEN_RING_SIZE];
+  pthread_t thread;
+
+  // tokens written and read so far. indexes wrap with RING_MASK. each
+  // counter is on its own cache line so the two threads don't share one
+  _Alignas(64) atomic_uint head;
+  _Alignas(64) atomic_uint tail;
+  atomic_bool isCancelled;
+
+  // consumer-side state: its own tail, and the last head it saw
+  _Alignas(64) uint32_t readCount;
+  uint32_t knownHead;
+  bool isAtEnd;
+  Token eof;
+};
+
+static void relax(int* spins) {
+  if (++*spins < SPIN_LIMIT) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  } else {
+    sched_yield();
+  }
+}
+
+//---------- START PRODUCER ------------//
+static void* produceTokens(void* argument) {
+  TokenStream* stream = argument;
+  uint32_t head = 0;
+  uint32_t knownTail = 0;
+
+  initScanner(stream->source);
+  for (;;) {
+    if (head - knownTail == TOKEN_RING_SIZE) {
+      atomic_store_explicit(&stream->head, head, memory_order_release);
+      int spins = 0;
+      while ((knownTail = atomic_load_explicit(
+                  &stream->tail, memory_order_acquire)) +
+                 TOKEN_RING_SIZE ==
+             head) {
+        // the parser stopped early, e.g. on a syntax error
+        if (atomic_load_explicit(&stream->isCancelled, memory_order_relaxed)) {
+          return NULL;
+        }
+        relax(&spins);
+      }
+    }
+
+    Token token = scanToken();
+    uint32_t slot = head & RING_MASK;
+    PackedToken* packed = &stream->ring[slot];
+    packed->type = (uint8_t)token.type;
+    packed->length = (uint32_t)token.length;
+    packed->line = (uint32_t)token.line;
+    if (token.type == TOKEN_ERROR) {
+      stream->errorMessages[slot] = token.start;
+    } else {
+      packed->offset = (uint32_t)(token.start - stream->source);
+    }
+    head++;
+
+    if (token.type == TOKEN_EOF) {
+      atomic_store_explicit(&stream->head, head, memory_order_release);
+      return NULL;
+    }
+    if ((head & (TOKEN_BATCH - 1)) == 0) {
+      atomic_store_explicit(&stream->head, head, memory_order_release);
+    }
+  }
+}
+//---------- END PRODUCER ------------//
+
+TokenStream* startTokenStream(const char* source, size_t length) {
+  if (length > UINT32_MAX) return NULL;
+
+  // the alignment keeps head and tail on separate cache lines
+  TokenStream* stream =
+      aligned_alloc(_Alignof(TokenStream), sizeof(TokenStream));
+  if (stream == NULL) return NULL;
+  stream->source = source;
+  atomic_init(&stream->head, 0);
+  atomic_init(&stream->tail, 0);
+  atomic_init(&stream->isCancelled, false);
+  stream->readCount = 0;
+  stream->knownHead = 0;
+  stream->isAtEnd = false;
+
+  // SIGPROF samples belong to the thread running the VM, so the producer
+  // starts with it blocked
+  sigset_t blocked, previous;
+  sigemptyset(&blocked);
+  sigaddset(&blocked, SIGPROF);
+  pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+  int error = pthread_create(&stream->thread, NULL, produceTokens, stream);
+  pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+  if (error != 0) {
+    free(stream);
+    return NULL;
+  }
+  return stream;
+}
+
+Token readToken(TokenStream* stream) {
+  if (stream->isAtEnd) return stream->eof;
+
+  if (stream->readCount == stream->knownHead) {
+    // let the producer refill everything read so far before waiting on it
+    atomic_store_explicit(&stream->tail, stream->readCount,
+                          memory_order_release);
+    int spins = 0;
+    while ((stream->knownHead = atomic_load_explicit(
+                &stream->head, memory_order_acquire)) == stream->readCount) {
+      relax(&spins);
+    }
+  }
+
+  uint32_t slot = stream->readCount & RING_MASK;
+  PackedToken* packed = &stream->ring[slot];
+  Token token;
+  token.type = (TokenType)packed->type;
+  token.start = token.type == TOKEN_ERROR
+                    ? stream->errorMessages[slot]
+                    : stream->source + packed->offset;
+  token.length = (int)packed->length;
+  token.line = (int)packed->line;
+
+  stream->readCount++;
+  if ((stream->readCount & (TOKEN_BATCH - 1)) == 0) {
+    atomic_store_explicit(&stream->tail, stream->readCount,
+                          memory_order_release);
+  }
+
+  if (token.type == TOKEN_EOF) {
+    stream->isAtEnd = true;
+    stream->eof = token;
+  }
+  return token;
+}
+
+void stopTokenStream(TokenStream* stream) {
+  atomic_store_explicit(&stream->isCancelled, true, memory_order_relaxed);
+  pthread_join(stream->thread, NULL);
+  free(stream);
+}
@@ -0,0 +1,30 @@
+#ifndef clox_lexer_h
+#define clox_lexer_h
+
+#include "common.h"
+#include "scanner.h"
+
+// scans a source on a producer thread, ahead of the parser. tokens reach
+// the parser through a single-producer/single-consumer ring, in the same
+// order and with the same contents scanToken() would have returned
+
+// tokens in the ring. must be a power of 2
+#define TOKEN_RING_SIZE 4096
+// each side publishes its position once per this many tokens, and before
+// it waits. must be a power of 2 that divides TOKEN_RING_SIZE
+#define TOKEN_BATCH 64
+
+typedef struct TokenStream TokenStream;
+
+// length is strlen(source). returns NULL when the thread can't be started
+// (or the source is too big to index with 32 bits); the caller scans
+// inline instead. the scanner belongs to the stream until
+// stopTokenStream()
+TokenStream* startTokenStream(const char* source, size_t length);
+// the next token. TOKEN_EOF repeats once reached
+Token readToken(TokenStream* stream);
+// stops the producer, which may not have reached the end, and frees the
+// stream
+void stopTokenStream(TokenStream* stream);
+
+#endif
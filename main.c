@@ -1,3 +1,7 @@
+// getline()
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,72 +9,200 @@
 #include "chunk.h"
 #include "common.h"
 #include "debug.h"
+#include "heap.h"
+#include "profile.h"
+#include "sampler.h"
+#include "source.h"
 #include "vm.h"
 
 static void repl() {
-  char line[1024];
+  // grown by getline to fit the longest line so far
+  char *line = NULL;
+  size_t capacity = 0;
 
   for (;;) {
     printf("> ");
 
-    if (!fgets(line, sizeof(line), stdin)) {
+    if (getline(&line, &capacity, stdin) == -1) {
       printf("\n");
       break;
     }
 
     interpret(line);
   }
+
+  free(line);
 }
 
-static char *readFile(const char *path) {
-  FILE *file = fopen(path, "rb");
-  if (file == NULL) {
-    fprintf(stderr, "Could not open file: %s.\n", path);
-    exit(74);
+// returns the process exit code
+static int runFile(const char *path) {
+  Source source;
+  switch (loadSource(&source, path)) {
+    case SOURCE_OK:
+      break;
+    case SOURCE_CANT_OPEN:
+      fprintf(stderr, "Could not open file: %s.\n", path);
+      exit(74);
+    case SOURCE_CANT_READ:
+      fprintf(stderr, "Could not read file: %s.\n", path);
+      exit(74);
+    case SOURCE_NO_MEMORY:
+      fprintf(stderr, "Not enough memory to read file: %s.\n", path);
+      exit(74);
   }
 
-  fseek(file, 0l, SEEK_END);
-  size_t size = ftell(file);
-  rewind(file);
+  InterpretResult result = interpret(source.chars);
+  freeSource(&source);
 
-  char *buffer = (char *)malloc(size + 1);
-  if (buffer == NULL) {
-    fprintf(stderr, "Not enough memory to read file: %s.\n", path);
-    exit(74);
-  }
+  if (result == INTERPRET_COMPILE_ERROR) return 65;
+  if (result == INTERPRET_RUNTIME_ERROR) return 70;
+  return 0;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "Usage: clox [--trace[=verbose]] [--memory-limit=BYTES] "
+          "[--lex-thread[=MIN_BYTES]] [--output-buffer=BYTES] "
+          "[--intern-max=LENGTH] "
+          "[--stats[=json]] [--heap-stats] [--heap-snapshot=PATH] "
+          "[--profile-sample[=HZ]] [--profile-folded=PATH] [path | -]\n");
+#ifdef PROFILE_OPCODES
+  fprintf(stderr, "       --profile[=json]  per-opcode report at exit\n");
+#endif
+  exit(65);
+}
 
-  size_t bytesRead = fread(buffer, sizeof(char), size, file);
-  if (bytesRead < size) {
-    fprintf(stderr, "Could not read file: %s.\n", path);
-    exit(74);
+static void writeFoldedFile(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    fprintf(stderr, "Could not open file: %s.\n", path);
+    return;
   }
 
-  buffer[bytesRead] = '\0';
-  return buffer;
+  writeFoldedStacks(file);
+  fclose(file);
 }
 
-static void runFile(const char *path) {
-  char *source = readFile(path);
-  InterpretResult result = interpret(source);
-  free(source);
+static void dumpHeapSnapshot(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    fprintf(stderr, "Could not open file: %s.\n", path);
+    return;
+  }
 
-  if (result == INTERPRET_COMPILE_ERROR) exit(65);
-  if (result == INTERPRET_RUNTIME_ERROR) exit(70);
+  writeHeapSnapshot(file);
+  fclose(file);
 }
 
 int main(int argc, const char **argv) {
   initVM();
 
-  // note: argc counts the program name as 1 arg
-  if (argc == 1) {
+  const char *path = NULL;
+  bool showHeapStats = false;
+  bool showStats = false;
+  bool isStatsJson = false;
+#ifdef PROFILE_OPCODES
+  bool showProfile = false;
+  bool isProfileJson = false;
+#endif
+  const char *snapshotPath = NULL;
+  // 0 unless sampling
+  int sampleHz = 0;
+  const char *foldedPath = NULL;
+  // note: argv[0] is the program name
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--memory-limit=", 15) == 0) {
+      char *end;
+      vm.memoryLimit = strtoull(argv[i] + 15, &end, 10);
+      if (end == argv[i] + 15 || *end != '\0') usage();
+    } else if (strncmp(argv[i], "--intern-max=", 13) == 0) {
+      char *end;
+      long length = strtol(argv[i] + 13, &end, 10);
+      if (end == argv[i] + 13 || *end != '\0' || length < 0 ||
+          length > INT_MAX) {
+        usage();
+      }
+      // 0 interns only ""; INT_MAX interns every literal
+      vm.internMaxLength = (int)length;
+    } else if (strcmp(argv[i], "--lex-thread") == 0) {
+      vm.lexThreadMinLength = LEX_THREAD_MIN_LENGTH;
+    } else if (strncmp(argv[i], "--lex-thread=", 13) == 0) {
+      char *end;
+      vm.lexThreadMinLength = strtoull(argv[i] + 13, &end, 10);
+      // 0 would turn it back off
+      if (end == argv[i] + 13 || *end != '\0' || vm.lexThreadMinLength == 0) {
+        usage();
+      }
+    } else if (strncmp(argv[i], "--output-buffer=", 16) == 0) {
+      char *end;
+      size_t size = strtoull(argv[i] + 16, &end, 10);
+      if (end == argv[i] + 16 || *end != '\0') usage();
+      // 0 writes every value as it's printed
+      setOutputBufferSize(size);
+    } else if (strcmp(argv[i], "--trace") == 0) {
+      vm.traceMode = TRACE_RING;
+    } else if (strcmp(argv[i], "--trace=verbose") == 0) {
+      vm.traceMode = TRACE_VERBOSE;
+#ifdef PROFILE_OPCODES
+    } else if (strcmp(argv[i], "--profile") == 0) {
+      showProfile = true;
+    } else if (strcmp(argv[i], "--profile=json") == 0) {
+      showProfile = true;
+      isProfileJson = true;
+#endif
+    } else if (strcmp(argv[i], "--profile-sample") == 0) {
+      sampleHz = SAMPLE_DEFAULT_HZ;
+    } else if (strncmp(argv[i], "--profile-sample=", 17) == 0) {
+      char *end;
+      sampleHz = (int)strtol(argv[i] + 17, &end, 10);
+      if (end == argv[i] + 17 || *end != '\0' || sampleHz <= 0) usage();
+    } else if (strncmp(argv[i], "--profile-folded=", 17) == 0) {
+      foldedPath = argv[i] + 17;
+      if (sampleHz == 0) sampleHz = SAMPLE_DEFAULT_HZ;
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      showStats = true;
+    } else if (strcmp(argv[i], "--stats=json") == 0) {
+      showStats = true;
+      isStatsJson = true;
+    } else if (strcmp(argv[i], "--heap-stats") == 0) {
+      showHeapStats = true;
+    } else if (strncmp(argv[i], "--heap-snapshot=", 16) == 0) {
+      snapshotPath = argv[i] + 16;
+    } else if ((argv[i][0] == '-' && strcmp(argv[i], "-") != 0) ||
+               path != NULL) {
+      usage();
+    } else {
+      path = argv[i];
+    }
+  }
+
+  if (sampleHz > 0 && !startSampling(sampleHz)) {
+    fprintf(stderr, "Could not start the sampling profiler.\n");
+    sampleHz = 0;
+  }
+
+  int exitCode = 0;
+  if (path == NULL) {
     repl();
-  } else if (argc == 2) {
-    runFile(argv[1]);
   } else {
-    fprintf(stderr, "Usage: clox [path]\n");
-    exit(65);
+    exitCode = runFile(path);
+  }
+
+  if (sampleHz > 0) {
+    stopSampling();
+    printSampleReport(stderr);
+    if (foldedPath != NULL) writeFoldedFile(foldedPath);
+    freeSamples();
   }
 
+  // taken before freeVM() so they show what the session left behind
+  if (showStats) printMetrics(stderr, isStatsJson);
+  if (showHeapStats) printHeapStats(stderr);
+  if (snapshotPath != NULL) dumpHeapSnapshot(snapshotPath);
+#ifdef PROFILE_OPCODES
+  if (showProfile) printOpcodeProfile(stderr, isProfileJson);
+#endif
+
   freeVM();
-  return 0;
+  return exitCode;
 }
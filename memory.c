@@ -1,36 +1,252 @@
 #include "memory.h"
 
+#include <setjmp.h>
 #include <stdlib.h>
 
+#include "compiler.h"
 #include "object.h"
+#include "pool.h"
+#include "table.h"
 #include "vm.h"
 
+#ifdef DEBUG_LOG_GC
+#include "output.h"
+#endif
+
+//---------- START DEFAULT ALLOCATOR ------------//
+static void* defaultAlloc(size_t size, void* userData) {
+  (void)userData;
+#ifdef USE_POOL_ALLOCATOR
+  return poolReallocate(NULL, 0, size);
+#else
+  return malloc(size);
+#endif
+}
+
+static void* defaultRealloc(void* pointer, size_t oldSize, size_t newSize,
+                            void* userData) {
+  (void)userData;
+#ifdef USE_POOL_ALLOCATOR
+  return poolReallocate(pointer, oldSize, newSize);
+#else
+  (void)oldSize;
+  return realloc(pointer, newSize);
+#endif
+}
+
+static void defaultFree(void* pointer, size_t size, void* userData) {
+  (void)userData;
+#ifdef USE_POOL_ALLOCATOR
+  poolReallocate(pointer, size, 0);
+#else
+  (void)size;
+  free(pointer);
+#endif
+}
+
+Allocator defaultAllocator() {
+  Allocator allocator = {defaultAlloc, defaultRealloc, defaultFree, NULL};
+  return allocator;
+}
+//---------- END DEFAULT ALLOCATOR ------------//
+
+static bool isOverLimit(size_t growth) {
+  return vm.memoryLimit != 0 && vm.bytesAllocated + growth > vm.memoryLimit;
+}
+
+// unwinds to the interpret() call that armed vm.memoryErrorJump
+static void memoryError() {
+  if (vm.memoryErrorJump != NULL) longjmp(*vm.memoryErrorJump, 1);
+  // nowhere to report it
+  exit(1);
+}
+
 void* reallocate(void* pointer, size_t oldSize, size_t newSize) {
+  if (newSize > oldSize) {
+#ifdef DEBUG_STRESS_GC
+    collectGarbage();
+#endif
+    size_t growth = newSize - oldSize;
+    if (vm.bytesAllocated + growth > vm.nextGC) collectGarbage();
+
+    // the limit only applies where it can be reported. a last collection
+    // gets a chance to make room first
+    if (vm.memoryErrorJump != NULL && isOverLimit(growth)) {
+      collectGarbage();
+      if (isOverLimit(growth)) memoryError();
+    }
+  }
+
+  void* result = NULL;
   if (newSize == 0) {
-    free(pointer);
-    return NULL;
+    vm.allocator.free(pointer, oldSize, vm.allocator.userData);
+  } else {
+    result = pointer == NULL
+                 ? vm.allocator.alloc(newSize, vm.allocator.userData)
+                 : vm.allocator.realloc(pointer, oldSize, newSize,
+                                        vm.allocator.userData);
+    if (result == NULL) memoryError();
   }
 
-  void* result = realloc(pointer, newSize);
-  if (result == NULL) {
-    exit(1);
+  // oldSize must be exact: it keeps the byte count that drives the GC honest
+  vm.bytesAllocated += newSize - oldSize;
+  if (vm.bytesAllocated > vm.peakBytesAllocated) {
+    vm.peakBytesAllocated = vm.bytesAllocated;
   }
 
   return result;
 }
 
+size_t objectSize(Obj* object) {
+  switch (object->type) {
+    case OBJ_STRING: {
+      ObjString* stringObj = (ObjString*)object;
+      switch (stringObj->storage) {
+        case STRING_INLINE:
+          return sizeof(ObjString) + stringObj->length + 1;
+        case STRING_BORROWED:
+        case STRING_DETACHED:
+          return sizeof(ObjString);
+        case STRING_PROMOTED:
+          return sizeof(ObjString) + stringObj->length + 1;
+      }
+      break;
+    }
+    case OBJ_NATIVE:
+      return sizeof(ObjNative);
+  }
+  return 0;
+}
+
 static void freeObject(Obj* object) {
   switch (object->type) {
     case OBJ_STRING: {
       ObjString* stringObj = (ObjString*)object;
-      // account for '\0'
-      FREE_ARRAY(char, stringObj->chars, stringObj->length + 1);
-      FREE(ObjString, stringObj);
+      switch (stringObj->storage) {
+        case STRING_INLINE:
+          // account for '\0'
+          reallocate(object, sizeof(ObjString) + stringObj->length + 1, 0);
+          break;
+        case STRING_BORROWED:
+        case STRING_DETACHED:
+          reallocate(object, sizeof(ObjString), 0);
+          break;
+        case STRING_PROMOTED:
+          FREE_ARRAY(char, stringObj->chars, stringObj->length + 1);
+          reallocate(object, sizeof(ObjString), 0);
+          break;
+      }
+      break;
+    }
+    case OBJ_NATIVE:
+      FREE(ObjNative, object);
+      break;
+  }
+}
+
+//---------- START GARBAGE COLLECTOR ------------//
+void markObject(Obj* object) {
+  if (object == NULL || object->isMarked) return;
+  object->isMarked = true;
+
+  // the gray stack is allocated with the system realloc so that growing it
+  // can't recursively trigger a collection
+  if (vm.grayCapacity < vm.grayCount + 1) {
+    vm.grayCapacity = GROW_CAPACITY(vm.grayCapacity);
+    vm.grayStack =
+        (Obj**)realloc(vm.grayStack, sizeof(Obj*) * vm.grayCapacity);
+    if (vm.grayStack == NULL) exit(1);
+  }
+
+  vm.grayStack[vm.grayCount++] = object;
+}
+
+void markValue(Value value) {
+  if (IS_OBJ(value)) markObject(AS_OBJ(value));
+}
+
+static void markArray(ValueArray* array) {
+  for (int i = 0; i < array->count; i++) {
+    markValue(array->values[i]);
+  }
+}
+
+static void blackenObject(Obj* object) {
+  switch (object->type) {
+    case OBJ_NATIVE:
+      markObject((Obj*)((ObjNative*)object)->name);
       break;
+    case OBJ_STRING:
+      break;
+  }
+}
+
+static void markRoots() {
+  for (Value* slot = vm.stack; slot < vm.stackTop; slot++) {
+    markValue(*slot);
+  }
+
+  if (vm.chunk != NULL) markArray(&vm.chunk->constants);
+
+  markTable(&vm.natives);
+  markCompilerRoots();
+}
+
+static void traceReferences() {
+  while (vm.grayCount > 0) {
+    Obj* object = vm.grayStack[--vm.grayCount];
+    blackenObject(object);
+  }
+}
+
+static void sweep() {
+  Obj* previous = NULL;
+  Obj* object = vm.objects;
+
+  while (object != NULL) {
+    if (object->isMarked) {
+      // reset for the next cycle
+      object->isMarked = false;
+      previous = object;
+      object = object->next;
+      continue;
+    }
+
+    Obj* unreached = object;
+    object = object->next;
+    if (previous != NULL) {
+      previous->next = object;
+    } else {
+      vm.objects = object;
     }
+
+    freeObject(unreached);
   }
 }
 
+void collectGarbage() {
+#ifdef DEBUG_LOG_GC
+  writeOutputString("-- gc begin\n");
+  size_t before = vm.bytesAllocated;
+#endif
+
+  markRoots();
+  traceReferences();
+  // vm.strings holds its keys weakly: drop the ones about to be freed
+  tableRemoveWhite(&vm.strings);
+  sweep();
+
+  vm.nextGC = vm.bytesAllocated * GC_HEAP_GROW_FACTOR;
+  if (vm.nextGC < GC_INITIAL_THRESHOLD) vm.nextGC = GC_INITIAL_THRESHOLD;
+
+#ifdef DEBUG_LOG_GC
+  writeOutputf("-- gc end: collected %zu bytes (from %zu to %zu) next at %zu\n",
+               before - vm.bytesAllocated, before, vm.bytesAllocated,
+               vm.nextGC);
+#endif
+}
+//---------- END GARBAGE COLLECTOR ------------//
+
 void freeObjects() {
   Obj* head = vm.objects;
   // traverse singly-linked list
@@ -39,4 +255,9 @@ void freeObjects() {
     freeObject(head);
     head = next;
   }
+
+  free(vm.grayStack);
+  vm.grayStack = NULL;
+  vm.grayCount = 0;
+  vm.grayCapacity = 0;
 }
@@ -2,10 +2,15 @@
 #define clox_memory_h
 
 #include "common.h"
+#include "value.h"
 
 #define ALLOCATE(type, count) \
   ((type*)reallocate(NULL, 0, (count) * sizeof(type)))
 
+// heap size after a collection is multiplied by this to get the next trigger
+#define GC_HEAP_GROW_FACTOR 2
+#define GC_INITIAL_THRESHOLD (1024 * 1024)
+
 #define GROW_CAPACITY(capacity) ((capacity < 8) ? 8 : (capacity)*2)
 
 #define GROW_ARRAY(type, pointer, oldCount, newCount) \
@@ -16,7 +21,28 @@
 
 #define FREE(type, pointer) reallocate(pointer, sizeof(type), 0)
 
+// where a VM gets its memory from. every call passes the exact size of the
+// block, so size-class allocators need no per-block header. alloc and
+// realloc return NULL when they're out of memory
+typedef struct {
+  void* (*alloc)(size_t size, void* userData);
+  void* (*realloc)(void* pointer, size_t oldSize, size_t newSize,
+                   void* userData);
+  void (*free)(void* pointer, size_t size, void* userData);
+  void* userData;
+} Allocator;
+
+// the size-class pools, or malloc with -DUSE_SYSTEM_MALLOC
+Allocator defaultAllocator();
+
+// all VM memory goes through here. running out of memory, or past
+// vm.memoryLimit, jumps to vm.memoryErrorJump when one is set
 void* reallocate(void* pointer, size_t oldSize, size_t newSize);
+// heap bytes owned by the object, its chars included
+size_t objectSize(Obj* object);
+void markObject(Obj* object);
+void markValue(Value value);
+void collectGarbage();
 void freeObjects();
 
 #endif
@@ -0,0 +1,100 @@
+// clock_gettime() is POSIX, which -std=c11 hides
+#define _POSIX_C_SOURCE 199309L
+
+#include "metrics.h"
+
+#include <string.h>
+#include <time.h>
+
+#include "vm.h"
+
+uint64_t metricsNow() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static const char* metricNames[METRIC_COUNT] = {
+    [METRIC_INSTRUCTIONS] = "instructions",
+    [METRIC_INTERPRET_CALLS] = "interpretCalls",
+    [METRIC_SCAN_NS] = "scanNs",
+    [METRIC_COMPILE_NS] = "compileNs",
+    [METRIC_RUN_NS] = "runNs",
+    [METRIC_FREE_NS] = "freeNs",
+    [METRIC_TOKENS] = "tokens",
+    [METRIC_INTERN_LOOKUPS] = "internLookups",
+    [METRIC_INTERN_HITS] = "internHits",
+    [METRIC_INTERN_SKIPS] = "internSkips",
+    [METRIC_PROMOTED_STRINGS] = "promotedStrings",
+    [METRIC_DETACHED_STRINGS] = "detachedStrings",
+    [METRIC_HASHED_BYTES] = "hashedBytes",
+    [METRIC_TABLE_LOOKUPS] = "tableLookups",
+    [METRIC_TABLE_RESIZES] = "tableResizes",
+    [METRIC_CONSTANTS] = "constants",
+    [METRIC_MAX_CONSTANTS] = "maxConstants",
+};
+
+void initMetrics(Metrics* metrics) {
+  memset(metrics, 0, sizeof(Metrics));
+
+  // the fastest of a few back-to-back reads is the clock's own cost
+  uint64_t overhead = UINT64_MAX;
+  for (int i = 0; i < 16; i++) {
+    uint64_t start = metricsNow();
+    uint64_t elapsed = metricsNow() - start;
+    if (elapsed < overhead) overhead = elapsed;
+  }
+  metrics->clockOverheadNs = overhead;
+}
+
+const char* metricName(Metric metric) { return metricNames[metric]; }
+
+uint64_t getMetric(Metric metric) { return vm.metrics.counters[metric]; }
+
+void getProbeHistogram(uint64_t* buckets) {
+  memcpy(buckets, vm.metrics.probeLengths, sizeof(vm.metrics.probeLengths));
+}
+
+static double internHitRate() {
+  uint64_t lookups = getMetric(METRIC_INTERN_LOOKUPS);
+  return lookups == 0 ? 0.0 : (double)getMetric(METRIC_INTERN_HITS) / lookups;
+}
+
+static void printText(FILE* out) {
+  for (int i = 0; i < METRIC_COUNT; i++) {
+    fprintf(out, "%-16s %16llu\n", metricName((Metric)i),
+            (unsigned long long)getMetric((Metric)i));
+  }
+  fprintf(out, "%-16s %16.4f\n", "internHitRate", internHitRate());
+
+  fprintf(out, "probe groups     lookups\n");
+  for (int i = 0; i < PROBE_HISTOGRAM_SIZE; i++) {
+    fprintf(out, "%10d%s %11llu\n", i + 1,
+            i == PROBE_HISTOGRAM_SIZE - 1 ? "+" : " ",
+            (unsigned long long)vm.metrics.probeLengths[i]);
+  }
+}
+
+static void printJson(FILE* out) {
+  fputc('{', out);
+  for (int i = 0; i < METRIC_COUNT; i++) {
+    fprintf(out, "\"%s\":%llu,", metricName((Metric)i),
+            (unsigned long long)getMetric((Metric)i));
+  }
+  fprintf(out, "\"internHitRate\":%.4f,", internHitRate());
+
+  fputs("\"probeLengths\":[", out);
+  for (int i = 0; i < PROBE_HISTOGRAM_SIZE; i++) {
+    fprintf(out, "%s%llu", i > 0 ? "," : "",
+            (unsigned long long)vm.metrics.probeLengths[i]);
+  }
+  fputs("]}\n", out);
+}
+
+void printMetrics(FILE* out, bool asJson) {
+  if (asJson) {
+    printJson(out);
+  } else {
+    printText(out);
+  }
+}
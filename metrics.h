@@ -0,0 +1,76 @@
+#ifndef clox_metrics_h
+#define clox_metrics_h
+
+#include <stdio.h>
+
+#include "common.h"
+
+// always-on counters for watching a VM in production. each one is a plain
+// uint64_t in vm.metrics, bumped in place: no locks, no lookups
+
+typedef enum {
+  METRIC_INSTRUCTIONS,
+  METRIC_INTERPRET_CALLS,
+  // wall time per interpret() phase. scanning is interleaved with
+  // compiling, so it is estimated from a sample of the tokens (see
+  // SCAN_TIMING_INTERVAL) and left out of compile time. sources scanned
+  // on the lexer thread add no scan time
+  METRIC_SCAN_NS,
+  METRIC_COMPILE_NS,
+  METRIC_RUN_NS,
+  METRIC_FREE_NS,
+  METRIC_TOKENS,
+  // lookups in vm.strings by copyString/borrowString/internString
+  METRIC_INTERN_LOOKUPS,
+  METRIC_INTERN_HITS,
+  // strings created without a lookup: too long, or from takeString
+  METRIC_INTERN_SKIPS,
+  // borrowed literals whose chars were copied when their chunk was freed,
+  // and those released without a copy
+  METRIC_PROMOTED_STRINGS,
+  METRIC_DETACHED_STRINGS,
+  METRIC_HASHED_BYTES,
+  METRIC_TABLE_LOOKUPS,
+  METRIC_TABLE_RESIZES,
+  METRIC_CONSTANTS,
+  // a gauge: the largest constant pool compiled so far
+  METRIC_MAX_CONSTANTS,
+  METRIC_COUNT
+} Metric;
+
+// bucket i counts table lookups that probed i + 1 groups. the last bucket
+// also takes every longer probe
+#define PROBE_HISTOGRAM_SIZE 8
+
+// 1 token in this many is timed, since reading the clock for every token
+// would cost more than scanning it. must be a power of 2
+#define SCAN_TIMING_INTERVAL 64
+
+typedef struct {
+  uint64_t counters[METRIC_COUNT];
+  uint64_t probeLengths[PROBE_HISTOGRAM_SIZE];
+
+  // bookkeeping for the phase timers
+  uint64_t phaseStart;
+  // scan time estimated for the current compile
+  uint64_t scanNs;
+  // cost of a metricsNow() pair, subtracted from each timed token
+  uint64_t clockOverheadNs;
+} Metrics;
+
+// VM metrics are reached through the vm global, declared in vm.h. tables
+// count into the Metrics they are given instead (see table.h)
+#define METRIC_ADD(metric, amount) (vm.metrics.counters[metric] += (amount))
+#define METRIC_INC(metric) METRIC_ADD(metric, 1)
+
+// CLOCK_MONOTONIC in nanoseconds
+uint64_t metricsNow();
+
+void initMetrics(Metrics* metrics);
+const char* metricName(Metric metric);
+uint64_t getMetric(Metric metric);
+// copies the probe histogram into buckets[PROBE_HISTOGRAM_SIZE]
+void getProbeHistogram(uint64_t* buckets);
+void printMetrics(FILE* out, bool asJson);
+
+#endif
@@ -0,0 +1,619 @@
+#include "number.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// more significant digits than fit in a uint64_t are dropped; whether any
+// of them were non-zero is kept
+#define MANTISSA_DIGITS 19
+// halfway points between doubles need no more digits than this, so the
+// fallback keeps this many and a non-zero stand-in for the rest
+#define FALLBACK_DIGITS 800
+// the range of POWERS_OF_FIVE
+#define POWER_MIN (-128)
+#define POWER_MAX 128
+// powers of ten a double holds exactly
+#define EXACT_POWER_MAX 22
+// significant digits %g prints by default
+#define FORMAT_DIGITS 6
+// the scaled value is within half an ulp of exact, about 6e-11 at 10^6.
+// any closer to a tie than this and the rounding error decides
+#define TIE_MARGIN 1e-9
+
+static const uint64_t integerPowersOfTen[] = {
+    1u,
+    10u,
+    100u,
+    1000u,
+    10000u,
+    100000u,
+    1000000u,
+    10000000u,
+    100000000u,
+    1000000000u,
+    10000000000u,
+    100000000000u,
+    1000000000000u,
+    10000000000000u,
+    100000000000000u,
+    1000000000000000u,
+    10000000000000000u,
+    100000000000000000u,
+    1000000000000000000u,
+    10000000000000000000u};
+
+static const double exactPowersOfTen[EXACT_POWER_MAX + 1] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// the top 128 bits of 5^q, normalized so the high bit is set. negative
+// powers are 2^b / 5^-q rounded up, where b keeps 128 bits (q >= -27) or
+// at least 128 bits beyond the leading one (q < -27), then truncated to
+// 128 bits. this is the table from Lemire, "Number Parsing at a Gigabyte
+// per Second", cut down to the exponents a literal without 'e' reaches
+// before it is too long to be worth anything but the fallback
+static const uint64_t powersOfFive[POWER_MAX - POWER_MIN + 1][2] = {
+    {0xDDD0467C64BCE4A0u, 0xAC7CB3F6D05DDBDEu}, // 5^-128
+    {0x8AA22C0DBEF60EE4u, 0x6BCDF07A423AA96Bu}, // 5^-127
+    {0xAD4AB7112EB3929Du, 0x86C16C98D2C953C6u}, // 5^-126
+    {0xD89D64D57A607744u, 0xE871C7BF077BA8B7u}, // 5^-125
+    {0x87625F056C7C4A8Bu, 0x11471CD764AD4972u}, // 5^-124
+    {0xA93AF6C6C79B5D2Du, 0xD598E40D3DD89BCFu}, // 5^-123
+    {0xD389B47879823479u, 0x4AFF1D108D4EC2C3u}, // 5^-122
+    {0x843610CB4BF160CBu, 0xCEDF722A585139BAu}, // 5^-121
+    {0xA54394FE1EEDB8FEu, 0xC2974EB4EE658828u}, // 5^-120
+    {0xCE947A3DA6A9273Eu, 0x733D226229FEEA32u}, // 5^-119
+    {0x811CCC668829B887u, 0x0806357D5A3F525Fu}, // 5^-118
+    {0xA163FF802A3426A8u, 0xCA07C2DCB0CF26F7u}, // 5^-117
+    {0xC9BCFF6034C13052u, 0xFC89B393DD02F0B5u}, // 5^-116
+    {0xFC2C3F3841F17C67u, 0xBBAC2078D443ACE2u}, // 5^-115
+    {0x9D9BA7832936EDC0u, 0xD54B944B84AA4C0Du}, // 5^-114
+    {0xC5029163F384A931u, 0x0A9E795E65D4DF11u}, // 5^-113
+    {0xF64335BCF065D37Du, 0x4D4617B5FF4A16D5u}, // 5^-112
+    {0x99EA0196163FA42Eu, 0x504BCED1BF8E4E45u}, // 5^-111
+    {0xC06481FB9BCF8D39u, 0xE45EC2862F71E1D6u}, // 5^-110
+    {0xF07DA27A82C37088u, 0x5D767327BB4E5A4Cu}, // 5^-109
+    {0x964E858C91BA2655u, 0x3A6A07F8D510F86Fu}, // 5^-108
+    {0xBBE226EFB628AFEAu, 0x890489F70A55368Bu}, // 5^-107
+    {0xEADAB0ABA3B2DBE5u, 0x2B45AC74CCEA842Eu}, // 5^-106
+    {0x92C8AE6B464FC96Fu, 0x3B0B8BC90012929Du}, // 5^-105
+    {0xB77ADA0617E3BBCBu, 0x09CE6EBB40173744u}, // 5^-104
+    {0xE55990879DDCAABDu, 0xCC420A6A101D0515u}, // 5^-103
+    {0x8F57FA54C2A9EAB6u, 0x9FA946824A12232Du}, // 5^-102
+    {0xB32DF8E9F3546564u, 0x47939822DC96ABF9u}, // 5^-101
+    {0xDFF9772470297EBDu, 0x59787E2B93BC56F7u}, // 5^-100
+    {0x8BFBEA76C619EF36u, 0x57EB4EDB3C55B65Au}, // 5^-99
+    {0xAEFAE51477A06B03u, 0xEDE622920B6B23F1u}, // 5^-98
+    {0xDAB99E59958885C4u, 0xE95FAB368E45ECEDu}, // 5^-97
+    {0x88B402F7FD75539Bu, 0x11DBCB0218EBB414u}, // 5^-96
+    {0xAAE103B5FCD2A881u, 0xD652BDC29F26A119u}, // 5^-95
+    {0xD59944A37C0752A2u, 0x4BE76D3346F0495Fu}, // 5^-94
+    {0x857FCAE62D8493A5u, 0x6F70A4400C562DDBu}, // 5^-93
+    {0xA6DFBD9FB8E5B88Eu, 0xCB4CCD500F6BB952u}, // 5^-92
+    {0xD097AD07A71F26B2u, 0x7E2000A41346A7A7u}, // 5^-91
+    {0x825ECC24C873782Fu, 0x8ED400668C0C28C8u}, // 5^-90
+    {0xA2F67F2DFA90563Bu, 0x728900802F0F32FAu}, // 5^-89
+    {0xCBB41EF979346BCAu, 0x4F2B40A03AD2FFB9u}, // 5^-88
+    {0xFEA126B7D78186BCu, 0xE2F610C84987BFA8u}, // 5^-87
+    {0x9F24B832E6B0F436u, 0x0DD9CA7D2DF4D7C9u}, // 5^-86
+    {0xC6EDE63FA05D3143u, 0x91503D1C79720DBBu}, // 5^-85
+    {0xF8A95FCF88747D94u, 0x75A44C6397CE912Au}, // 5^-84
+    {0x9B69DBE1B548CE7Cu, 0xC986AFBE3EE11ABAu}, // 5^-83
+    {0xC24452DA229B021Bu, 0xFBE85BADCE996168u}, // 5^-82
+    {0xF2D56790AB41C2A2u, 0xFAE27299423FB9C3u}, // 5^-81
+    {0x97C560BA6B0919A5u, 0xDCCD879FC967D41Au}, // 5^-80
+    {0xBDB6B8E905CB600Fu, 0x5400E987BBC1C920u}, // 5^-79
+    {0xED246723473E3813u, 0x290123E9AAB23B68u}, // 5^-78
+    {0x9436C0760C86E30Bu, 0xF9A0B6720AAF6521u}, // 5^-77
+    {0xB94470938FA89BCEu, 0xF808E40E8D5B3E69u}, // 5^-76
+    {0xE7958CB87392C2C2u, 0xB60B1D1230B20E04u}, // 5^-75
+    {0x90BD77F3483BB9B9u, 0xB1C6F22B5E6F48C2u}, // 5^-74
+    {0xB4ECD5F01A4AA828u, 0x1E38AEB6360B1AF3u}, // 5^-73
+    {0xE2280B6C20DD5232u, 0x25C6DA63C38DE1B0u}, // 5^-72
+    {0x8D590723948A535Fu, 0x579C487E5A38AD0Eu}, // 5^-71
+    {0xB0AF48EC79ACE837u, 0x2D835A9DF0C6D851u}, // 5^-70
+    {0xDCDB1B2798182244u, 0xF8E431456CF88E65u}, // 5^-69
+    {0x8A08F0F8BF0F156Bu, 0x1B8E9ECB641B58FFu}, // 5^-68
+    {0xAC8B2D36EED2DAC5u, 0xE272467E3D222F3Fu}, // 5^-67
+    {0xD7ADF884AA879177u, 0x5B0ED81DCC6ABB0Fu}, // 5^-66
+    {0x86CCBB52EA94BAEAu, 0x98E947129FC2B4E9u}, // 5^-65
+    {0xA87FEA27A539E9A5u, 0x3F2398D747B36224u}, // 5^-64
+    {0xD29FE4B18E88640Eu, 0x8EEC7F0D19A03AADu}, // 5^-63
+    {0x83A3EEEEF9153E89u, 0x1953CF68300424ACu}, // 5^-62
+    {0xA48CEAAAB75A8E2Bu, 0x5FA8C3423C052DD7u}, // 5^-61
+    {0xCDB02555653131B6u, 0x3792F412CB06794Du}, // 5^-60
+    {0x808E17555F3EBF11u, 0xE2BBD88BBEE40BD0u}, // 5^-59
+    {0xA0B19D2AB70E6ED6u, 0x5B6ACEAEAE9D0EC4u}, // 5^-58
+    {0xC8DE047564D20A8Bu, 0xF245825A5A445275u}, // 5^-57
+    {0xFB158592BE068D2Eu, 0xEED6E2F0F0D56712u}, // 5^-56
+    {0x9CED737BB6C4183Du, 0x55464DD69685606Bu}, // 5^-55
+    {0xC428D05AA4751E4Cu, 0xAA97E14C3C26B886u}, // 5^-54
+    {0xF53304714D9265DFu, 0xD53DD99F4B3066A8u}, // 5^-53
+    {0x993FE2C6D07B7FABu, 0xE546A8038EFE4029u}, // 5^-52
+    {0xBF8FDB78849A5F96u, 0xDE98520472BDD033u}, // 5^-51
+    {0xEF73D256A5C0F77Cu, 0x963E66858F6D4440u}, // 5^-50
+    {0x95A8637627989AADu, 0xDDE7001379A44AA8u}, // 5^-49
+    {0xBB127C53B17EC159u, 0x5560C018580D5D52u}, // 5^-48
+    {0xE9D71B689DDE71AFu, 0xAAB8F01E6E10B4A6u}, // 5^-47
+    {0x9226712162AB070Du, 0xCAB3961304CA70E8u}, // 5^-46
+    {0xB6B00D69BB55C8D1u, 0x3D607B97C5FD0D22u}, // 5^-45
+    {0xE45C10C42A2B3B05u, 0x8CB89A7DB77C506Au}, // 5^-44
+    {0x8EB98A7A9A5B04E3u, 0x77F3608E92ADB242u}, // 5^-43
+    {0xB267ED1940F1C61Cu, 0x55F038B237591ED3u}, // 5^-42
+    {0xDF01E85F912E37A3u, 0x6B6C46DEC52F6688u}, // 5^-41
+    {0x8B61313BBABCE2C6u, 0x2323AC4B3B3DA015u}, // 5^-40
+    {0xAE397D8AA96C1B77u, 0xABEC975E0A0D081Au}, // 5^-39
+    {0xD9C7DCED53C72255u, 0x96E7BD358C904A21u}, // 5^-38
+    {0x881CEA14545C7575u, 0x7E50D64177DA2E54u}, // 5^-37
+    {0xAA242499697392D2u, 0xDDE50BD1D5D0B9E9u}, // 5^-36
+    {0xD4AD2DBFC3D07787u, 0x955E4EC64B44E864u}, // 5^-35
+    {0x84EC3C97DA624AB4u, 0xBD5AF13BEF0B113Eu}, // 5^-34
+    {0xA6274BBDD0FADD61u, 0xECB1AD8AEACDD58Eu}, // 5^-33
+    {0xCFB11EAD453994BAu, 0x67DE18EDA5814AF2u}, // 5^-32
+    {0x81CEB32C4B43FCF4u, 0x80EACF948770CED7u}, // 5^-31
+    {0xA2425FF75E14FC31u, 0xA1258379A94D028Du}, // 5^-30
+    {0xCAD2F7F5359A3B3Eu, 0x096EE45813A04330u}, // 5^-29
+    {0xFD87B5F28300CA0Du, 0x8BCA9D6E188853FCu}, // 5^-28
+    {0x9E74D1B791E07E48u, 0x775EA264CF55347Eu}, // 5^-27
+    {0xC612062576589DDAu, 0x95364AFE032A819Eu}, // 5^-26
+    {0xF79687AED3EEC551u, 0x3A83DDBD83F52205u}, // 5^-25
+    {0x9ABE14CD44753B52u, 0xC4926A9672793543u}, // 5^-24
+    {0xC16D9A0095928A27u, 0x75B7053C0F178294u}, // 5^-23
+    {0xF1C90080BAF72CB1u, 0x5324C68B12DD6339u}, // 5^-22
+    {0x971DA05074DA7BEEu, 0xD3F6FC16EBCA5E04u}, // 5^-21
+    {0xBCE5086492111AEAu, 0x88F4BB1CA6BCF585u}, // 5^-20
+    {0xEC1E4A7DB69561A5u, 0x2B31E9E3D06C32E6u}, // 5^-19
+    {0x9392EE8E921D5D07u, 0x3AFF322E62439FD0u}, // 5^-18
+    {0xB877AA3236A4B449u, 0x09BEFEB9FAD487C3u}, // 5^-17
+    {0xE69594BEC44DE15Bu, 0x4C2EBE687989A9B4u}, // 5^-16
+    {0x901D7CF73AB0ACD9u, 0x0F9D37014BF60A11u}, // 5^-15
+    {0xB424DC35095CD80Fu, 0x538484C19EF38C95u}, // 5^-14
+    {0xE12E13424BB40E13u, 0x2865A5F206B06FBAu}, // 5^-13
+    {0x8CBCCC096F5088CBu, 0xF93F87B7442E45D4u}, // 5^-12
+    {0xAFEBFF0BCB24AAFEu, 0xF78F69A51539D749u}, // 5^-11
+    {0xDBE6FECEBDEDD5BEu, 0xB573440E5A884D1Cu}, // 5^-10
+    {0x89705F4136B4A597u, 0x31680A88F8953031u}, // 5^-9
+    {0xABCC77118461CEFCu, 0xFDC20D2B36BA7C3Eu}, // 5^-8
+    {0xD6BF94D5E57A42BCu, 0x3D32907604691B4Du}, // 5^-7
+    {0x8637BD05AF6C69B5u, 0xA63F9A49C2C1B110u}, // 5^-6
+    {0xA7C5AC471B478423u, 0x0FCF80DC33721D54u}, // 5^-5
+    {0xD1B71758E219652Bu, 0xD3C36113404EA4A9u}, // 5^-4
+    {0x83126E978D4FDF3Bu, 0x645A1CAC083126EAu}, // 5^-3
+    {0xA3D70A3D70A3D70Au, 0x3D70A3D70A3D70A4u}, // 5^-2
+    {0xCCCCCCCCCCCCCCCCu, 0xCCCCCCCCCCCCCCCDu}, // 5^-1
+    {0x8000000000000000u, 0x0000000000000000u}, // 5^0
+    {0xA000000000000000u, 0x0000000000000000u}, // 5^1
+    {0xC800000000000000u, 0x0000000000000000u}, // 5^2
+    {0xFA00000000000000u, 0x0000000000000000u}, // 5^3
+    {0x9C40000000000000u, 0x0000000000000000u}, // 5^4
+    {0xC350000000000000u, 0x0000000000000000u}, // 5^5
+    {0xF424000000000000u, 0x0000000000000000u}, // 5^6
+    {0x9896800000000000u, 0x0000000000000000u}, // 5^7
+    {0xBEBC200000000000u, 0x0000000000000000u}, // 5^8
+    {0xEE6B280000000000u, 0x0000000000000000u}, // 5^9
+    {0x9502F90000000000u, 0x0000000000000000u}, // 5^10
+    {0xBA43B74000000000u, 0x0000000000000000u}, // 5^11
+    {0xE8D4A51000000000u, 0x0000000000000000u}, // 5^12
+    {0x9184E72A00000000u, 0x0000000000000000u}, // 5^13
+    {0xB5E620F480000000u, 0x0000000000000000u}, // 5^14
+    {0xE35FA931A0000000u, 0x0000000000000000u}, // 5^15
+    {0x8E1BC9BF04000000u, 0x0000000000000000u}, // 5^16
+    {0xB1A2BC2EC5000000u, 0x0000000000000000u}, // 5^17
+    {0xDE0B6B3A76400000u, 0x0000000000000000u}, // 5^18
+    {0x8AC7230489E80000u, 0x0000000000000000u}, // 5^19
+    {0xAD78EBC5AC620000u, 0x0000000000000000u}, // 5^20
+    {0xD8D726B7177A8000u, 0x0000000000000000u}, // 5^21
+    {0x878678326EAC9000u, 0x0000000000000000u}, // 5^22
+    {0xA968163F0A57B400u, 0x0000000000000000u}, // 5^23
+    {0xD3C21BCECCEDA100u, 0x0000000000000000u}, // 5^24
+    {0x84595161401484A0u, 0x0000000000000000u}, // 5^25
+    {0xA56FA5B99019A5C8u, 0x0000000000000000u}, // 5^26
+    {0xCECB8F27F4200F3Au, 0x0000000000000000u}, // 5^27
+    {0x813F3978F8940984u, 0x4000000000000000u}, // 5^28
+    {0xA18F07D736B90BE5u, 0x5000000000000000u}, // 5^29
+    {0xC9F2C9CD04674EDEu, 0xA400000000000000u}, // 5^30
+    {0xFC6F7C4045812296u, 0x4D00000000000000u}, // 5^31
+    {0x9DC5ADA82B70B59Du, 0xF020000000000000u}, // 5^32
+    {0xC5371912364CE305u, 0x6C28000000000000u}, // 5^33
+    {0xF684DF56C3E01BC6u, 0xC732000000000000u}, // 5^34
+    {0x9A130B963A6C115Cu, 0x3C7F400000000000u}, // 5^35
+    {0xC097CE7BC90715B3u, 0x4B9F100000000000u}, // 5^36
+    {0xF0BDC21ABB48DB20u, 0x1E86D40000000000u}, // 5^37
+    {0x96769950B50D88F4u, 0x1314448000000000u}, // 5^38
+    {0xBC143FA4E250EB31u, 0x17D955A000000000u}, // 5^39
+    {0xEB194F8E1AE525FDu, 0x5DCFAB0800000000u}, // 5^40
+    {0x92EFD1B8D0CF37BEu, 0x5AA1CAE500000000u}, // 5^41
+    {0xB7ABC627050305ADu, 0xF14A3D9E40000000u}, // 5^42
+    {0xE596B7B0C643C719u, 0x6D9CCD05D0000000u}, // 5^43
+    {0x8F7E32CE7BEA5C6Fu, 0xE4820023A2000000u}, // 5^44
+    {0xB35DBF821AE4F38Bu, 0xDDA2802C8A800000u}, // 5^45
+    {0xE0352F62A19E306Eu, 0xD50B2037AD200000u}, // 5^46
+    {0x8C213D9DA502DE45u, 0x4526F422CC340000u}, // 5^47
+    {0xAF298D050E4395D6u, 0x9670B12B7F410000u}, // 5^48
+    {0xDAF3F04651D47B4Cu, 0x3C0CDD765F114000u}, // 5^49
+    {0x88D8762BF324CD0Fu, 0xA5880A69FB6AC800u}, // 5^50
+    {0xAB0E93B6EFEE0053u, 0x8EEA0D047A457A00u}, // 5^51
+    {0xD5D238A4ABE98068u, 0x72A4904598D6D880u}, // 5^52
+    {0x85A36366EB71F041u, 0x47A6DA2B7F864750u}, // 5^53
+    {0xA70C3C40A64E6C51u, 0x999090B65F67D924u}, // 5^54
+    {0xD0CF4B50CFE20765u, 0xFFF4B4E3F741CF6Du}, // 5^55
+    {0x82818F1281ED449Fu, 0xBFF8F10E7A8921A4u}, // 5^56
+    {0xA321F2D7226895C7u, 0xAFF72D52192B6A0Du}, // 5^57
+    {0xCBEA6F8CEB02BB39u, 0x9BF4F8A69F764490u}, // 5^58
+    {0xFEE50B7025C36A08u, 0x02F236D04753D5B4u}, // 5^59
+    {0x9F4F2726179A2245u, 0x01D762422C946590u}, // 5^60
+    {0xC722F0EF9D80AAD6u, 0x424D3AD2B7B97EF5u}, // 5^61
+    {0xF8EBAD2B84E0D58Bu, 0xD2E0898765A7DEB2u}, // 5^62
+    {0x9B934C3B330C8577u, 0x63CC55F49F88EB2Fu}, // 5^63
+    {0xC2781F49FFCFA6D5u, 0x3CBF6B71C76B25FBu}, // 5^64
+    {0xF316271C7FC3908Au, 0x8BEF464E3945EF7Au}, // 5^65
+    {0x97EDD871CFDA3A56u, 0x97758BF0E3CBB5ACu}, // 5^66
+    {0xBDE94E8E43D0C8ECu, 0x3D52EEED1CBEA317u}, // 5^67
+    {0xED63A231D4C4FB27u, 0x4CA7AAA863EE4BDDu}, // 5^68
+    {0x945E455F24FB1CF8u, 0x8FE8CAA93E74EF6Au}, // 5^69
+    {0xB975D6B6EE39E436u, 0xB3E2FD538E122B44u}, // 5^70
+    {0xE7D34C64A9C85D44u, 0x60DBBCA87196B616u}, // 5^71
+    {0x90E40FBEEA1D3A4Au, 0xBC8955E946FE31CDu}, // 5^72
+    {0xB51D13AEA4A488DDu, 0x6BABAB6398BDBE41u}, // 5^73
+    {0xE264589A4DCDAB14u, 0xC696963C7EED2DD1u}, // 5^74
+    {0x8D7EB76070A08AECu, 0xFC1E1DE5CF543CA2u}, // 5^75
+    {0xB0DE65388CC8ADA8u, 0x3B25A55F43294BCBu}, // 5^76
+    {0xDD15FE86AFFAD912u, 0x49EF0EB713F39EBEu}, // 5^77
+    {0x8A2DBF142DFCC7ABu, 0x6E3569326C784337u}, // 5^78
+    {0xACB92ED9397BF996u, 0x49C2C37F07965404u}, // 5^79
+    {0xD7E77A8F87DAF7FBu, 0xDC33745EC97BE906u}, // 5^80
+    {0x86F0AC99B4E8DAFDu, 0x69A028BB3DED71A3u}, // 5^81
+    {0xA8ACD7C0222311BCu, 0xC40832EA0D68CE0Cu}, // 5^82
+    {0xD2D80DB02AABD62Bu, 0xF50A3FA490C30190u}, // 5^83
+    {0x83C7088E1AAB65DBu, 0x792667C6DA79E0FAu}, // 5^84
+    {0xA4B8CAB1A1563F52u, 0x577001B891185938u}, // 5^85
+    {0xCDE6FD5E09ABCF26u, 0xED4C0226B55E6F86u}, // 5^86
+    {0x80B05E5AC60B6178u, 0x544F8158315B05B4u}, // 5^87
+    {0xA0DC75F1778E39D6u, 0x696361AE3DB1C721u}, // 5^88
+    {0xC913936DD571C84Cu, 0x03BC3A19CD1E38E9u}, // 5^89
+    {0xFB5878494ACE3A5Fu, 0x04AB48A04065C723u}, // 5^90
+    {0x9D174B2DCEC0E47Bu, 0x62EB0D64283F9C76u}, // 5^91
+    {0xC45D1DF942711D9Au, 0x3BA5D0BD324F8394u}, // 5^92
+    {0xF5746577930D6500u, 0xCA8F44EC7EE36479u}, // 5^93
+    {0x9968BF6ABBE85F20u, 0x7E998B13CF4E1ECBu}, // 5^94
+    {0xBFC2EF456AE276E8u, 0x9E3FEDD8C321A67Eu}, // 5^95
+    {0xEFB3AB16C59B14A2u, 0xC5CFE94EF3EA101Eu}, // 5^96
+    {0x95D04AEE3B80ECE5u, 0xBBA1F1D158724A12u}, // 5^97
+    {0xBB445DA9CA61281Fu, 0x2A8A6E45AE8EDC97u}, // 5^98
+    {0xEA1575143CF97226u, 0xF52D09D71A3293BDu}, // 5^99
+    {0x924D692CA61BE758u, 0x593C2626705F9C56u}, // 5^100
+    {0xB6E0C377CFA2E12Eu, 0x6F8B2FB00C77836Cu}, // 5^101
+    {0xE498F455C38B997Au, 0x0B6DFB9C0F956447u}, // 5^102
+    {0x8EDF98B59A373FECu, 0x4724BD4189BD5EACu}, // 5^103
+    {0xB2977EE300C50FE7u, 0x58EDEC91EC2CB657u}, // 5^104
+    {0xDF3D5E9BC0F653E1u, 0x2F2967B66737E3EDu}, // 5^105
+    {0x8B865B215899F46Cu, 0xBD79E0D20082EE74u}, // 5^106
+    {0xAE67F1E9AEC07187u, 0xECD8590680A3AA11u}, // 5^107
+    {0xDA01EE641A708DE9u, 0xE80E6F4820CC9495u}, // 5^108
+    {0x884134FE908658B2u, 0x3109058D147FDCDDu}, // 5^109
+    {0xAA51823E34A7EEDEu, 0xBD4B46F0599FD415u}, // 5^110
+    {0xD4E5E2CDC1D1EA96u, 0x6C9E18AC7007C91Au}, // 5^111
+    {0x850FADC09923329Eu, 0x03E2CF6BC604DDB0u}, // 5^112
+    {0xA6539930BF6BFF45u, 0x84DB8346B786151Cu}, // 5^113
+    {0xCFE87F7CEF46FF16u, 0xE612641865679A63u}, // 5^114
+    {0x81F14FAE158C5F6Eu, 0x4FCB7E8F3F60C07Eu}, // 5^115
+    {0xA26DA3999AEF7749u, 0xE3BE5E330F38F09Du}, // 5^116
+    {0xCB090C8001AB551Cu, 0x5CADF5BFD3072CC5u}, // 5^117
+    {0xFDCB4FA002162A63u, 0x73D9732FC7C8F7F6u}, // 5^118
+    {0x9E9F11C4014DDA7Eu, 0x2867E7FDDCDD9AFAu}, // 5^119
+    {0xC646D63501A1511Du, 0xB281E1FD541501B8u}, // 5^120
+    {0xF7D88BC24209A565u, 0x1F225A7CA91A4226u}, // 5^121
+    {0x9AE757596946075Fu, 0x3375788DE9B06958u}, // 5^122
+    {0xC1A12D2FC3978937u, 0x0052D6B1641C83AEu}, // 5^123
+    {0xF209787BB47D6B84u, 0xC0678C5DBD23A49Au}, // 5^124
+    {0x9745EB4D50CE6332u, 0xF840B7BA963646E0u}, // 5^125
+    {0xBD176620A501FBFFu, 0xB650E5A93BC3D898u}, // 5^126
+    {0xEC5D3FA8CE427AFFu, 0xA3E51F138AB4CEBEu}, // 5^127
+    {0x93BA47C980E98CDFu, 0xC66F336C36B10137u}, // 5^128
+};
+
+//---------- START EISEL-LEMIRE ------------//
+// w * 10^q rounded to the nearest double, or false when the 128-bit
+// product can't tell which way to round. w is non-zero and q is in
+// [POWER_MIN, POWER_MAX], which is inside the normal range, so neither
+// subnormals nor infinity come up
+static bool eiselLemire(uint64_t w, int q, double* value) {
+  int leadingZeros = __builtin_clzll(w);
+  w <<= leadingZeros;
+
+  const uint64_t* power = powersOfFive[q - POWER_MIN];
+  unsigned __int128 product = (unsigned __int128)w * power[0];
+  uint64_t high = (uint64_t)(product >> 64);
+  uint64_t low = (uint64_t)product;
+  // 55 bits are needed: 53 for the result, one to round with, and one
+  // more because the product may start a bit lower. when the bits under
+  // those are all ones, the truncated power may have carried into them
+  if ((high & 0x1ff) == 0x1ff) {
+    uint64_t carry = (uint64_t)(((unsigned __int128)w * power[1]) >> 64);
+    low += carry;
+    if (low < carry) high++;
+    // still all ones: only the exponents where 5^q is exact are certain
+    if (low == UINT64_MAX && (q < -27 || q > 55)) return false;
+  }
+
+  int upperBit = (int)(high >> 63);
+  int shift = upperBit + 64 - 52 - 3;
+  uint64_t mantissa = high >> shift;
+  // floor(log2(10^q)) + 63, plus the bias
+  int exponent =
+      (((152170 + 65536) * q) >> 16) + 63 + upperBit - leadingZeros + 1023;
+
+  // exactly halfway between two doubles, which only happens when 5^q
+  // fits in 64 bits: round down to even rather than up
+  if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 &&
+      (mantissa << shift) == high) {
+    mantissa &= ~(uint64_t)1;
+  }
+  mantissa += mantissa & 1;
+  mantissa >>= 1;
+  // rounding up carried into the next binade
+  if (mantissa >= (uint64_t)2 << 52) {
+    mantissa = (uint64_t)1 << 52;
+    exponent++;
+  }
+  mantissa &= ~((uint64_t)1 << 52);
+
+  uint64_t bits = mantissa | (uint64_t)exponent << 52;
+  memcpy(value, &bits, sizeof(bits));
+  return true;
+}
+//---------- END EISEL-LEMIRE ------------//
+
+// the literal's digits, canonicalized into a bounded "DIGITSeEXP" for
+// strtod(). the token isn't '\0'-terminated where it ends, and strtod()
+// would read on into e.g. "1e5" or "0x10"
+static double parseSlow(const char* start, int length) {
+  char buffer[FALLBACK_DIGITS + 2 + 16];
+  int digits = 0;
+  int exponent = 0;
+  bool isFraction = false;
+  bool isTruncated = false;
+
+  for (int i = 0; i < length; i++) {
+    char c = start[i];
+    if (c == '.') {
+      isFraction = true;
+    } else if (digits == 0 && c == '0') {
+      // leading zeros only place the point
+      if (isFraction) exponent--;
+    } else if (digits < FALLBACK_DIGITS) {
+      buffer[digits++] = c;
+      if (isFraction) exponent--;
+    } else {
+      if (!isFraction) exponent++;
+      if (c != '0') isTruncated = true;
+    }
+  }
+  if (digits == 0) return 0.0;
+
+  // any digit past the last one kept is enough to break a tie
+  if (isTruncated) {
+    buffer[digits++] = '1';
+    exponent--;
+  }
+  snprintf(buffer + digits, sizeof(buffer) - (size_t)digits, "e%d", exponent);
+  return strtod(buffer, NULL);
+}
+
+double parseNumber(const char* start, int length) {
+  const char* current = start;
+  const char* end = start + length;
+  uint64_t mantissa = 0;
+  int digits = 0;
+  // value = mantissa * 10^exponent, give or take the dropped digits
+  int exponent = 0;
+  bool isTruncated = false;
+
+  while (current < end && *current == '0') current++;
+  for (; current < end && *current != '.'; current++) {
+    if (digits < MANTISSA_DIGITS) {
+      mantissa = mantissa * 10 + (uint64_t)(*current - '0');
+      digits++;
+    } else {
+      exponent++;
+      if (*current != '0') isTruncated = true;
+    }
+  }
+  if (current < end) {
+    // skip the '.'
+    for (current++; current < end; current++) {
+      if (digits < MANTISSA_DIGITS) {
+        mantissa = mantissa * 10 + (uint64_t)(*current - '0');
+        exponent--;
+        // zeros right after the point aren't significant
+        if (mantissa != 0) digits++;
+      } else if (*current != '0') {
+        isTruncated = true;
+      }
+    }
+  }
+
+  if (mantissa == 0) return 0.0;
+
+#if FLT_EVAL_METHOD == 0
+  // both operands are exact, so the one rounding is the right one
+  if (!isTruncated && mantissa <= (uint64_t)1 << 53 &&
+      exponent >= -EXACT_POWER_MAX && exponent <= EXACT_POWER_MAX) {
+    double value = (double)mantissa;
+    return exponent < 0 ? value / exactPowersOfTen[-exponent]
+                        : value * exactPowersOfTen[exponent];
+  }
+#endif
+
+  if (exponent >= POWER_MIN && exponent <= POWER_MAX) {
+    double value;
+    if (!isTruncated) {
+      if (eiselLemire(mantissa, exponent, &value)) return value;
+    } else {
+      // the dropped digits put the literal between mantissa and
+      // mantissa + 1. when both round the same way, so does it
+      double above;
+      if (eiselLemire(mantissa, exponent, &value) &&
+          eiselLemire(mantissa + 1, exponent, &above) && value == above) {
+        return value;
+      }
+    }
+  }
+
+  return parseSlow(start, length);
+}
+
+//---------- START FORMATTING ------------//
+// writes digits, which has exactly FORMAT_DIGITS digits, the first one
+// worth 10^exponent. fixed or exponential, without trailing zeros, as %g
+static int writeDigits(char* buffer, bool isNegative, uint32_t digits,
+                       int exponent) {
+  char chars[FORMAT_DIGITS];
+  for (int i = FORMAT_DIGITS - 1; i >= 0; i--) {
+    chars[i] = (char)('0' + digits % 10);
+    digits /= 10;
+  }
+  int count = FORMAT_DIGITS;
+  while (count > 1 && chars[count - 1] == '0') count--;
+
+  char* out = buffer;
+  if (isNegative) *out++ = '-';
+  if (exponent < -4 || exponent >= FORMAT_DIGITS) {
+    *out++ = chars[0];
+    if (count > 1) {
+      *out++ = '.';
+      memcpy(out, chars + 1, (size_t)count - 1);
+      out += count - 1;
+    }
+    *out++ = 'e';
+    *out++ = exponent < 0 ? '-' : '+';
+    int magnitude = exponent < 0 ? -exponent : exponent;
+    // at least two digits
+    if (magnitude >= 100) {
+      *out++ = (char)('0' + magnitude / 100);
+      magnitude %= 100;
+    }
+    *out++ = (char)('0' + magnitude / 10);
+    *out++ = (char)('0' + magnitude % 10);
+  } else if (exponent >= 0) {
+    int integerDigits = exponent + 1;
+    for (int i = 0; i < integerDigits; i++) {
+      *out++ = i < count ? chars[i] : '0';
+    }
+    if (count > integerDigits) {
+      *out++ = '.';
+      memcpy(out, chars + integerDigits, (size_t)(count - integerDigits));
+      out += count - integerDigits;
+    }
+  } else {
+    *out++ = '0';
+    *out++ = '.';
+    for (int i = -1; i > exponent; i--) *out++ = '0';
+    memcpy(out, chars, (size_t)count);
+    out += count;
+  }
+
+  *out = '\0';
+  return (int)(out - buffer);
+}
+
+// integers short of 2^64, rounded to FORMAT_DIGITS digits exactly
+static int formatInteger(char* buffer, bool isNegative, uint64_t integer) {
+  if (integer < integerPowersOfTen[FORMAT_DIGITS]) {
+    char chars[FORMAT_DIGITS];
+    int count = 0;
+    do {
+      chars[FORMAT_DIGITS - ++count] = (char)('0' + integer % 10);
+      integer /= 10;
+    } while (integer != 0);
+
+    char* out = buffer;
+    if (isNegative) *out++ = '-';
+    memcpy(out, chars + FORMAT_DIGITS - count, (size_t)count);
+    out += count;
+    *out = '\0';
+    return (int)(out - buffer);
+  }
+
+  int exponent = FORMAT_DIGITS;
+  while (exponent < 19 && integer >= integerPowersOfTen[exponent + 1]) {
+    exponent++;
+  }
+  uint64_t divisor = integerPowersOfTen[exponent - FORMAT_DIGITS + 1];
+  uint64_t digits = integer / divisor;
+  uint64_t remainder = integer % divisor;
+  // ties to even, like snprintf()
+  uint64_t half = divisor / 2;
+  if (remainder > half || (remainder == half && (digits & 1) != 0)) digits++;
+  if (digits == integerPowersOfTen[FORMAT_DIGITS]) {
+    digits /= 10;
+    exponent++;
+  }
+  return writeDigits(buffer, isNegative, (uint32_t)digits, exponent);
+}
+
+// nan and inf, subnormals and the far exponents, and near-ties
+static int formatSlow(double value, char* buffer) {
+  return snprintf(buffer, NUMBER_FORMAT_MAX, "%g", value);
+}
+
+int formatNumber(double value, char* buffer) {
+  if (!isfinite(value)) return formatSlow(value, buffer);
+
+  bool isNegative = signbit(value);
+  double magnitude = fabs(value);
+  // 2^64
+  if (magnitude < 18446744073709551616.0) {
+    uint64_t integer = (uint64_t)magnitude;
+    if ((double)integer == magnitude) {
+      return formatInteger(buffer, isNegative, integer);
+    }
+  }
+
+  // floor(log10(magnitude)) or one less, from the binary exponent
+  uint64_t bits;
+  memcpy(&bits, &magnitude, sizeof(bits));
+  int binaryExponent = (int)(bits >> 52) - 1023;
+  int exponent = (binaryExponent * 78913) >> 18;
+
+  // the first FORMAT_DIGITS digits before the point, scaled by one exact
+  // power of ten, so rounded once
+  double scaled = 0;
+  int scale = 0;
+  for (int attempt = 0; attempt < 2; attempt++) {
+    scale = FORMAT_DIGITS - 1 - exponent;
+    if (scale < -EXACT_POWER_MAX || scale > EXACT_POWER_MAX) {
+      return formatSlow(value, buffer);
+    }
+    scaled = scale < 0 ? magnitude / exactPowersOfTen[-scale]
+                       : magnitude * exactPowersOfTen[scale];
+    if (scaled < (double)integerPowersOfTen[FORMAT_DIGITS]) break;
+    exponent++;
+  }
+
+  uint32_t digits = (uint32_t)scaled;
+  double fraction = scaled - digits;
+  if (fabs(fraction - 0.5) >= TIE_MARGIN) {
+    if (fraction > 0.5) digits++;
+  } else if (scale >= 0) {
+    // the product's rounding error is exact, and so is its sum's sign
+    double error = fma(magnitude, exactPowersOfTen[scale], -scaled);
+    double distance = (fraction - 0.5) + error;
+    if (distance > 0 || (distance == 0 && (digits & 1) != 0)) digits++;
+  } else {
+    return formatSlow(value, buffer);
+  }
+  if (digits == integerPowersOfTen[FORMAT_DIGITS]) {
+    digits /= 10;
+    exponent++;
+  }
+  if (digits < integerPowersOfTen[FORMAT_DIGITS - 1] ||
+      digits >= integerPowersOfTen[FORMAT_DIGITS]) {
+    return formatSlow(value, buffer);
+  }
+  return writeDigits(buffer, isNegative, digits, exponent);
+}
+//---------- END FORMATTING ------------//
@@ -0,0 +1,18 @@
+#ifndef clox_number_h
+#define clox_number_h
+
+#include "common.h"
+
+// converts a number literal, as the scanner matches it (digits with an
+// optional '.' and more digits), to the nearest double. ties go to even,
+// exactly as strtod() rounds. start needn't be '\0'-terminated past length
+double parseNumber(const char* start, int length);
+
+// enough for any number formatNumber() writes, and its '\0'
+#define NUMBER_FORMAT_MAX 32
+
+// writes the number as printf("%g") does, into a buffer of
+// NUMBER_FORMAT_MAX bytes. returns the length, not counting the '\0'
+int formatNumber(double value, char* buffer);
+
+#endif
@@ -1,9 +1,9 @@
 #include "object.h"
 
-#include <stdio.h>
 #include <string.h>
 
 #include "memory.h"
+#include "output.h"
 #include "table.h"
 #include "value.h"
 #include "vm.h"
@@ -14,65 +14,258 @@
 static Obj* allocateObject(size_t size, ObjType type) {
   Obj* object = (Obj*)reallocate(NULL, 0, size);
   object->type = type;
+  object->isMarked = false;
   object->next = vm.objects;
   vm.objects = object;
   return object;
 }
 
-static ObjString* allocateString(char* string, int length, uint32_t hash) {
-  ObjString* stringObj = ALLOCATE_OBJ(ObjString, OBJ_STRING);
-  stringObj->chars = string;
+static ObjString* allocateStringObj(size_t size, int length) {
+  ObjString* stringObj = (ObjString*)allocateObject(size, OBJ_STRING);
   stringObj->length = length;
+  stringObj->hash = 0;
+  stringObj->isHashed = false;
+  stringObj->isInterned = false;
+  return stringObj;
+}
+
+ObjString* allocateString(int length) {
+  ObjString* stringObj =
+      allocateStringObj(sizeof(ObjString) + length + 1, length);
+  stringObj->storage = STRING_INLINE;
+  stringObj->chars = stringObj->inlineChars;
+  stringObj->chars[length] = '\0';
+  return stringObj;
+}
+
+static ObjString* allocateBorrowedString(const char* string, int length) {
+  ObjString* stringObj = allocateStringObj(sizeof(ObjString), length);
+  stringObj->storage = STRING_BORROWED;
+  // never written through: borrowed chars are promoted before any mutation
+  stringObj->chars = (char*)string;
+  return stringObj;
+}
+
+static ObjString* copyChars(const char* string, int length) {
+  ObjString* stringObj = allocateString(length);
+  memcpy(stringObj->chars, string, length);
+  return stringObj;
+}
+
+static ObjString* internNewString(ObjString* stringObj, uint32_t hash) {
   stringObj->hash = hash;
+  stringObj->isHashed = true;
+  stringObj->isInterned = true;
 
+  // growing the table may collect: keep the new string reachable
+  push(OBJ_VAL(stringObj));
   tableSet(&vm.strings, stringObj, NIL_VAL());
+  pop();
   return stringObj;
 }
 
-static uint32_t hashString(const char* key, int length) {
-  uint32_t hash = 2166136261u;
+//---------- START STRING HASHING ------------//
+// wyhash-style hash: consumes the key 8 bytes at a time and mixes with a
+// 64x64->128 bit multiply, instead of FNV-1a's byte-at-a-time loop
+static const uint64_t HASH_SECRET[4] = {
+    0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull,
+    0x589965cc75374cc3ull};
 
-  for (int i = 0; i < length; i++) {
-    hash ^= key[i];
-    hash *= 16777619;
+// unaligned loads. memcpy compiles down to a single mov
+static inline uint64_t read64(const uint8_t* p) {
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static inline uint64_t read32(const uint8_t* p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+// full 128-bit product of a and b, stored back as (low, high)
+static inline void multiply128(uint64_t* a, uint64_t* b) {
+#ifdef __SIZEOF_INT128__
+  __uint128_t product = (__uint128_t)*a * *b;
+  *a = (uint64_t)product;
+  *b = (uint64_t)(product >> 64);
+#else
+  uint64_t aHigh = *a >> 32, aLow = (uint32_t)*a;
+  uint64_t bHigh = *b >> 32, bLow = (uint32_t)*b;
+  uint64_t high = aHigh * bHigh, middle0 = aHigh * bLow;
+  uint64_t middle1 = aLow * bHigh, low = aLow * bLow;
+  uint64_t t = low + (middle0 << 32);
+  uint64_t carry = t < low;
+  uint64_t lowResult = t + (middle1 << 32);
+  carry += lowResult < t;
+  *a = lowResult;
+  *b = high + (middle0 >> 32) + (middle1 >> 32) + carry;
+#endif
+}
+
+static inline uint64_t mix(uint64_t a, uint64_t b) {
+  multiply128(&a, &b);
+  return a ^ b;
+}
+
+uint32_t hashString(const char* key, int length) {
+  METRIC_ADD(METRIC_HASHED_BYTES, length);
+  const uint8_t* p = (const uint8_t*)key;
+  size_t remaining = (size_t)length;
+  uint64_t seed = mix(HASH_SECRET[0], HASH_SECRET[1]);
+  uint64_t a, b;
+
+  if (remaining <= 16) {
+    if (remaining >= 4) {
+      // 2 overlapping 4-byte reads from each end cover 4..16 bytes
+      size_t shift = (remaining >> 3) << 2;
+      a = (read32(p) << 32) | read32(p + shift);
+      b = (read32(p + remaining - 4) << 32) |
+          read32(p + remaining - 4 - shift);
+    } else if (remaining > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[remaining >> 1] << 8) |
+          p[remaining - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    if (remaining > 48) {
+      // 3 independent lanes keep the multipliers busy on long strings
+      uint64_t lane1 = seed, lane2 = seed;
+      do {
+        seed = mix(read64(p) ^ HASH_SECRET[1], read64(p + 8) ^ seed);
+        lane1 = mix(read64(p + 16) ^ HASH_SECRET[2], read64(p + 24) ^ lane1);
+        lane2 = mix(read64(p + 32) ^ HASH_SECRET[3], read64(p + 40) ^ lane2);
+        p += 48;
+        remaining -= 48;
+      } while (remaining > 48);
+      seed ^= lane1 ^ lane2;
+    }
+
+    while (remaining > 16) {
+      seed = mix(read64(p) ^ HASH_SECRET[1], read64(p + 8) ^ seed);
+      p += 16;
+      remaining -= 16;
+    }
+
+    // last 16 bytes, possibly overlapping what was already consumed
+    a = read64(p + remaining - 16);
+    b = read64(p + remaining - 8);
   }
 
-  return hash;
+  a ^= HASH_SECRET[1];
+  b ^= seed;
+  multiply128(&a, &b);
+  uint64_t hash =
+      mix(a ^ HASH_SECRET[0] ^ (uint64_t)length, b ^ HASH_SECRET[1]);
+
+  // fold to the 32 bits stored in ObjString
+  return (uint32_t)(hash ^ (hash >> 32));
 }
+//---------- END STRING HASHING ------------//
 
-// public interface for allocateString
 ObjString* takeString(char* string, int length) {
+  // runtime results are rarely compared, so they are neither hashed nor
+  // interned up front. equality falls back to comparing the chars
+  METRIC_INC(METRIC_INTERN_SKIPS);
+  ObjString* stringObj = copyChars(string, length);
+  FREE_ARRAY(char, string, length + 1);
+  return stringObj;
+}
+
+ObjString* internString(const char* string, int length) {
   uint32_t hash = hashString(string, length);
 
+  METRIC_INC(METRIC_INTERN_LOOKUPS);
   ObjString* internedString =
       tableFindString(&vm.strings, string, length, hash);
   if (internedString != NULL) {
-    // free the original string since we don't need it anymore
-    FREE_ARRAY(char, string, length + 1);
+    METRIC_INC(METRIC_INTERN_HITS);
     return internedString;
   }
 
-  return allocateString(string, length, hash);
+  return internNewString(copyChars(string, length), hash);
 }
 
 ObjString* copyString(const char* string, int length) {
+  if (length > vm.internMaxLength) {
+    METRIC_INC(METRIC_INTERN_SKIPS);
+    return copyChars(string, length);
+  }
+
+  return internString(string, length);
+}
+
+ObjString* borrowString(const char* string, int length) {
+  if (length > vm.internMaxLength) {
+    METRIC_INC(METRIC_INTERN_SKIPS);
+    return allocateBorrowedString(string, length);
+  }
+
   uint32_t hash = hashString(string, length);
 
+  METRIC_INC(METRIC_INTERN_LOOKUPS);
   ObjString* internedString =
       tableFindString(&vm.strings, string, length, hash);
-  if (internedString != NULL) return internedString;
+  if (internedString != NULL) {
+    METRIC_INC(METRIC_INTERN_HITS);
+    return internedString;
+  }
 
-  char* heapChars = ALLOCATE(char, length + 1);
-  memcpy(heapChars, string, length);
-  heapChars[length] = '\0';
+  return internNewString(allocateBorrowedString(string, length), hash);
+}
+
+void promoteString(ObjString* string) {
+  if (string->storage != STRING_BORROWED) return;
+  METRIC_INC(METRIC_PROMOTED_STRINGS);
+
+  char* heapChars = ALLOCATE(char, string->length + 1);
+  memcpy(heapChars, string->chars, string->length);
+  heapChars[string->length] = '\0';
+
+  string->chars = heapChars;
+  string->storage = STRING_PROMOTED;
+}
+
+void detachString(ObjString* string) {
+  if (string->storage != STRING_BORROWED) return;
+  METRIC_INC(METRIC_DETACHED_STRINGS);
 
-  return allocateString(heapChars, length, hash);
+  string->chars = NULL;
+  string->storage = STRING_DETACHED;
+}
+
+ObjNative* newNative(ObjString* name, NativeFn function, int arity) {
+  ObjNative* native = ALLOCATE_OBJ(ObjNative, OBJ_NATIVE);
+  native->function = function;
+  native->numericFunction = NULL;
+  native->arity = arity;
+  native->name = name;
+  return native;
+}
+
+ObjNative* newNumericNative(ObjString* name, NumericNativeFn function) {
+  ObjNative* native = ALLOCATE_OBJ(ObjNative, OBJ_NATIVE);
+  native->function = NULL;
+  native->numericFunction = function;
+  native->arity = 1;
+  native->name = name;
+  return native;
 }
 
 void printObject(Value value) {
   switch (OBJ_TYPE(value)) {
-    case OBJ_STRING:
-      printf("%s", AS_CSTRING(value));
+    case OBJ_STRING: {
+      // borrowed chars are not NUL-terminated
+      ObjString* string = AS_STRING(value);
+      writeOutput(string->chars, (size_t)string->length);
+      break;
+    }
+    case OBJ_NATIVE:
+      writeOutputf("<native fn %.*s>", AS_NATIVE(value)->name->length,
+                   AS_NATIVE(value)->name->chars);
       break;
   }
 }
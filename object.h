@@ -6,24 +6,83 @@
 
 typedef enum {
   OBJ_STRING,
+  OBJ_NATIVE,
 } ObjType;
 
+#define OBJ_TYPE_COUNT (OBJ_NATIVE + 1)
+
 struct Obj {
   ObjType type;
+  bool isMarked;
   struct Obj* next;
 };
 
+typedef enum {
+  // chars follow the header in the same allocation
+  STRING_INLINE,
+  // chars point into the source buffer of the chunk being compiled/run
+  STRING_BORROWED,
+  // borrowed chars that were copied to the heap when their source died
+  STRING_PROMOTED,
+  // borrowed, but the source died and nothing copied the chars: chars is
+  // NULL. only unreachable strings are detached, to wait for the sweep
+  STRING_DETACHED,
+} StringStorage;
+
 struct ObjString {
   Obj obj;
   int length;
-  char* chars;
+  // only valid once isHashed is set; see stringHash()
   uint32_t hash;
+  bool isHashed;
+  // interned strings are unique in vm.strings and compare by identity
+  bool isInterned;
+  StringStorage storage;
+  // points at inlineChars unless the string is borrowed/promoted
+  char* chars;
+  char inlineChars[];
 };
 
-// creates a ObjString directly from a given string
+// host function callable from Lox. args points directly into vm.stack and
+// is only valid for the duration of the call.
+typedef Value (*NativeFn)(int argCount, Value* args);
+// fast path for pure numeric natives (sqrt, floor...): no Value marshalling
+typedef double (*NumericNativeFn)(double arg);
+
+typedef struct {
+  Obj obj;
+  NativeFn function;
+  // non-NULL for numeric natives, which always take exactly 1 argument
+  NumericNativeFn numericFunction;
+  int arity;
+  ObjString* name;
+} ObjNative;
+
+// allocates a string with room for length chars (plus '\0') for the caller
+// to fill in. used for strings produced at runtime, which skip the intern
+// table
+ObjString* allocateString(int length);
+// creates a ObjString from a heap-allocated string, freeing it. prefer
+// allocateString to build the chars in place
 ObjString* takeString(char* string, int length);
-// creates a ObjString by copying the given string first
+// creates a ObjString by copying the given string first. interned when no
+// longer than vm.internMaxLength
 ObjString* copyString(const char* string, int length);
+// like copyString, but always interned. use for strings used as table keys
+ObjString* internString(const char* string, int length);
+// like copyString, but the chars are not copied: the string points into the
+// given buffer, which must outlive it or be promoted (or detached) first
+ObjString* borrowString(const char* string, int length);
+// copies the chars of a borrowed string so it no longer depends on its source
+void promoteString(ObjString* string);
+// drops a borrowed string's chars without copying them. for strings that
+// can't be reached once their source is gone
+void detachString(ObjString* string);
+
+uint32_t hashString(const char* key, int length);
+
+ObjNative* newNative(ObjString* name, NativeFn function, int arity);
+ObjNative* newNumericNative(ObjString* name, NumericNativeFn function);
 
 void printObject(Value value);
 
@@ -33,8 +92,20 @@ static inline bool isObjType(Value value, ObjType type) {
   return IS_OBJ(value) && OBJ_TYPE(value) == type;
 }
 
+// strings that skip the intern table are hashed lazily on first use
+static inline uint32_t stringHash(ObjString* string) {
+  if (!string->isHashed) {
+    string->hash = hashString(string->chars, string->length);
+    string->isHashed = true;
+  }
+  return string->hash;
+}
+
 #define IS_STRING(value) (isObjType(value, OBJ_STRING))
+#define IS_NATIVE(value) (isObjType(value, OBJ_NATIVE))
 #define AS_STRING(value) ((ObjString*)AS_OBJ(value))
+// note: borrowed strings are not NUL-terminated, always use the length
 #define AS_CSTRING(value) (((ObjString*)AS_OBJ(value))->chars)
+#define AS_NATIVE(value) ((ObjNative*)AS_OBJ(value))
 
 #endif
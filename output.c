@@ -0,0 +1,116 @@
+#include "output.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vm.h"
+
+// one stdio call per flush rather than per value. stdout's own buffer
+// still orders this with the REPL prompt
+static void writeStdout(const char* chars, size_t length, void* context) {
+  (void)context;
+  fwrite(chars, 1, length, stdout);
+}
+
+// the buffer isn't heap memory: it doesn't count against memoryLimit and
+// can't set off a collection. when it can't be had, output is unbuffered
+static void allocateBuffer(Output* output, size_t size) {
+  output->buffer = size > 0 ? malloc(size) : NULL;
+  output->capacity = output->buffer != NULL ? size : 0;
+  output->length = 0;
+}
+
+void initOutput(Output* output) {
+  output->writer = writeStdout;
+  output->context = NULL;
+  allocateBuffer(output, OUTPUT_BUFFER_SIZE);
+}
+
+void freeOutput(Output* output) {
+  if (output->length > 0) {
+    output->writer(output->buffer, output->length, output->context);
+  }
+  free(output->buffer);
+  output->buffer = NULL;
+  output->length = 0;
+  output->capacity = 0;
+}
+
+void setOutputBufferSize(size_t size) {
+  flushOutput();
+  free(vm.output.buffer);
+  allocateBuffer(&vm.output, size);
+}
+
+void setOutputWriter(OutputWriter writer, void* context) {
+  flushOutput();
+  vm.output.writer = writer != NULL ? writer : writeStdout;
+  vm.output.context = context;
+}
+
+void writeOutput(const char* chars, size_t length) {
+  Output* output = &vm.output;
+  if (length == 0) return;
+  if (length > output->capacity - output->length) {
+    flushOutput();
+    // too big to buffer at all
+    if (length > output->capacity) {
+      output->writer(chars, length, output->context);
+      return;
+    }
+  }
+
+  memcpy(output->buffer + output->length, chars, length);
+  output->length += length;
+}
+
+void writeOutputString(const char* string) {
+  writeOutput(string, strlen(string));
+}
+
+void writeOutputf(const char* format, ...) {
+  Output* output = &vm.output;
+  // straight into the buffer when it fits. vsnprintf() wants room for a
+  // '\0' it writes but that isn't kept
+  size_t space = output->capacity - output->length;
+  char* end = output->buffer != NULL ? output->buffer + output->length : NULL;
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(end, space, format, args);
+  va_end(args);
+  if (length < 0) return;
+  if ((size_t)length < space) {
+    output->length += (size_t)length;
+    return;
+  }
+
+  // otherwise again, into an emptied buffer or on its own
+  flushOutput();
+  va_start(args, format);
+  if ((size_t)length < output->capacity) {
+    vsnprintf(output->buffer, output->capacity, format, args);
+    output->length = (size_t)length;
+  } else {
+    char* chars = malloc((size_t)length + 1);
+    if (chars != NULL) {
+      vsnprintf(chars, (size_t)length + 1, format, args);
+      if (length > 0) output->writer(chars, (size_t)length, output->context);
+      free(chars);
+    }
+  }
+  va_end(args);
+}
+
+void flushOutput() {
+  Output* output = &vm.output;
+  if (output->length == 0) return;
+  output->writer(output->buffer, output->length, output->context);
+  output->length = 0;
+}
+
+void flushOutputBeforeError() {
+  flushOutput();
+  fflush(stdout);
+}
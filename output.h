@@ -0,0 +1,49 @@
+#ifndef clox_output_h
+#define clox_output_h
+
+#include "common.h"
+
+// everything the VM prints to stdout: results, and the disassembly, stack
+// traces and GC log of the DEBUG_* builds. it collects in vm.output's
+// buffer and reaches the writer (stdout unless an embedder sets one) when
+// the buffer fills, at the end of interpret(), and before an error is
+// written to stderr
+
+// default size of vm.output's buffer
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+// takes a flushed buffer's contents. length is never 0
+typedef void (*OutputWriter)(const char* chars, size_t length, void* context);
+
+typedef struct {
+  char* buffer;
+  size_t length;
+  // 0 hands every write straight to the writer
+  size_t capacity;
+  OutputWriter writer;
+  void* context;
+} Output;
+
+void initOutput(Output* output);
+// flushes first
+void freeOutput(Output* output);
+
+// the rest act on vm.output
+
+// flushes, then buffers up to size bytes. 0 turns buffering off
+void setOutputBufferSize(size_t size);
+// flushes to the old writer first. a NULL writer means stdout
+void setOutputWriter(OutputWriter writer, void* context);
+
+void writeOutput(const char* chars, size_t length);
+void writeOutputString(const char* string);
+__attribute__((format(printf, 1, 2))) void writeOutputf(const char* format,
+                                                        ...);
+
+// hands everything buffered to the writer
+void flushOutput();
+// flushOutput(), then stdout's own buffer, so what was printed comes out
+// before the error that follows it on stderr
+void flushOutputBeforeError();
+
+#endif
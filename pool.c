@@ -0,0 +1,164 @@
+#include "pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// slabs are chained through a header that keeps blocks 16-byte aligned
+typedef struct Slab {
+  struct Slab* next;
+  char padding[POOL_GRANULARITY - sizeof(struct Slab*)];
+} Slab;
+
+// free blocks are chained through their first word
+typedef struct FreeBlock {
+  struct FreeBlock* next;
+} FreeBlock;
+
+typedef struct {
+  Slab* slabs;
+  FreeBlock* freeList;
+  int slabCount;
+  size_t blocksInUse;
+} SizeClass;
+
+static SizeClass classes[POOL_CLASS_COUNT];
+
+static inline bool isPooled(size_t size) {
+  return size > 0 && size <= POOL_MAX_SIZE;
+}
+
+static inline int classOf(size_t size) {
+  return (int)((size - 1) / POOL_GRANULARITY);
+}
+
+static inline size_t blockSizeOf(int sizeClass) {
+  return (size_t)(sizeClass + 1) * POOL_GRANULARITY;
+}
+
+static inline size_t blocksPerSlab(int sizeClass) {
+  return (POOL_SLAB_SIZE - sizeof(Slab)) / blockSizeOf(sizeClass);
+}
+
+// carves a fresh slab into blocks on the class's free list
+static bool addSlab(int sizeClass) {
+  Slab* slab = (Slab*)malloc(POOL_SLAB_SIZE);
+  if (slab == NULL) return false;
+
+  SizeClass* pool = &classes[sizeClass];
+  slab->next = pool->slabs;
+  pool->slabs = slab;
+  pool->slabCount++;
+
+  size_t blockSize = blockSizeOf(sizeClass);
+  char* block = (char*)slab + sizeof(Slab);
+  // push in reverse so blocks are handed out in address order
+  for (size_t i = blocksPerSlab(sizeClass); i > 0; i--) {
+    FreeBlock* freeBlock = (FreeBlock*)(block + (i - 1) * blockSize);
+    freeBlock->next = pool->freeList;
+    pool->freeList = freeBlock;
+  }
+
+  return true;
+}
+
+static void* poolAllocate(size_t size) {
+  int sizeClass = classOf(size);
+  SizeClass* pool = &classes[sizeClass];
+
+  if (pool->freeList == NULL && !addSlab(sizeClass)) return NULL;
+
+  FreeBlock* block = pool->freeList;
+  pool->freeList = block->next;
+  pool->blocksInUse++;
+  return block;
+}
+
+static void poolFree(void* pointer, size_t size) {
+  SizeClass* pool = &classes[classOf(size)];
+  FreeBlock* block = (FreeBlock*)pointer;
+  block->next = pool->freeList;
+  pool->freeList = block;
+  pool->blocksInUse--;
+}
+
+void* poolReallocate(void* pointer, size_t oldSize, size_t newSize) {
+  bool isOldPooled = pointer != NULL && isPooled(oldSize);
+
+  if (newSize == 0) {
+    if (isOldPooled) {
+      poolFree(pointer, oldSize);
+    } else {
+      free(pointer);
+    }
+    return NULL;
+  }
+
+  if (!isOldPooled && !isPooled(newSize)) return realloc(pointer, newSize);
+
+  // still fits the same block
+  if (isOldPooled && isPooled(newSize) &&
+      classOf(oldSize) == classOf(newSize)) {
+    return pointer;
+  }
+
+  // moving between classes, or between the pools and the system allocator
+  void* result = isPooled(newSize) ? poolAllocate(newSize) : malloc(newSize);
+  if (result == NULL) return NULL;
+
+  if (pointer != NULL) {
+    memcpy(result, pointer, oldSize < newSize ? oldSize : newSize);
+    if (isOldPooled) {
+      poolFree(pointer, oldSize);
+    } else {
+      free(pointer);
+    }
+  }
+
+  return result;
+}
+
+void freePools() {
+  for (int i = 0; i < POOL_CLASS_COUNT; i++) {
+    Slab* slab = classes[i].slabs;
+    while (slab != NULL) {
+      Slab* next = slab->next;
+      free(slab);
+      slab = next;
+    }
+
+    classes[i].slabs = NULL;
+    classes[i].freeList = NULL;
+    classes[i].slabCount = 0;
+    classes[i].blocksInUse = 0;
+  }
+}
+
+void getPoolClassStats(int sizeClass, PoolClassStats* stats) {
+  SizeClass* pool = &classes[sizeClass];
+  stats->blockSize = blockSizeOf(sizeClass);
+  stats->slabCount = pool->slabCount;
+  stats->blocksInUse = pool->blocksInUse;
+  stats->blockCapacity = (size_t)pool->slabCount * blocksPerSlab(sizeClass);
+}
+
+void printPoolStats(FILE* out) {
+  fprintf(out, "%-6s %8s %12s %12s %8s\n", "class", "slabs", "blocks used",
+          "blocks total", "util");
+
+  size_t totalSlabs = 0, usedBytes = 0;
+  for (int i = 0; i < POOL_CLASS_COUNT; i++) {
+    PoolClassStats stats;
+    getPoolClassStats(i, &stats);
+    if (stats.slabCount == 0) continue;
+
+    fprintf(out, "%-6zu %8d %12zu %12zu %7.1f%%\n", stats.blockSize,
+            stats.slabCount, stats.blocksInUse, stats.blockCapacity,
+            100.0 * stats.blocksInUse / stats.blockCapacity);
+    totalSlabs += stats.slabCount;
+    usedBytes += stats.blocksInUse * stats.blockSize;
+  }
+
+  size_t slabBytes = totalSlabs * POOL_SLAB_SIZE;
+  fprintf(out, "slab bytes %zu, in use %zu (%.1f%%)\n", slabBytes, usedBytes,
+          slabBytes == 0 ? 0.0 : 100.0 * usedBytes / slabBytes);
+}
@@ -0,0 +1,35 @@
+#ifndef clox_pool_h
+#define clox_pool_h
+
+#include <stdio.h>
+
+#include "common.h"
+
+// size-class pool allocator for heap objects and small buffers. requests
+// of up to POOL_MAX_SIZE bytes are rounded up to a multiple of
+// POOL_GRANULARITY and served from page-sized slabs through per-class free
+// lists. larger ones go to the system allocator.
+// like reallocate(), every call must pass the exact size of the block.
+#define POOL_SLAB_SIZE 4096
+#define POOL_GRANULARITY 16
+#define POOL_MAX_SIZE 256
+#define POOL_CLASS_COUNT (POOL_MAX_SIZE / POOL_GRANULARITY)
+
+typedef struct {
+  size_t blockSize;
+  int slabCount;
+  size_t blocksInUse;
+  // blocks carved out of this class's slabs, used or not
+  size_t blockCapacity;
+} PoolClassStats;
+
+// behaves like realloc, with free() when newSize is 0. returns NULL when
+// the system is out of memory
+void* poolReallocate(void* pointer, size_t oldSize, size_t newSize);
+// releases every slab. blocks still in use become invalid
+void freePools();
+
+void getPoolClassStats(int sizeClass, PoolClassStats* stats);
+void printPoolStats(FILE* out);
+
+#endif
@@ -0,0 +1,138 @@
+// profileClock() may use clock_gettime()
+#define _POSIX_C_SOURCE 199309L
+
+#include "profile.h"
+
+#ifdef PROFILE_OPCODES
+
+#include <stdlib.h>
+
+#include "debug.h"
+
+// pairs listed in the report
+#define PROFILE_TOP_PAIRS 16
+
+OpcodeProfile opcodeProfile;
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PROFILE_CLOCK_UNIT "cycles"
+#else
+#define PROFILE_CLOCK_UNIT "ns"
+#endif
+
+typedef struct {
+  uint8_t first;
+  uint8_t second;
+  uint64_t count;
+} OpcodePair;
+
+void initOpcodeProfile() {
+  opcodeProfile = (OpcodeProfile){0};
+  opcodeProfile.current = -1;
+}
+
+static int compareOpcodes(const void* a, const void* b) {
+  uint8_t left = *(const uint8_t*)a;
+  uint8_t right = *(const uint8_t*)b;
+  uint64_t leftTicks = opcodeProfile.ticks[left];
+  uint64_t rightTicks = opcodeProfile.ticks[right];
+  if (leftTicks != rightTicks) return leftTicks < rightTicks ? 1 : -1;
+  return (int)left - (int)right;
+}
+
+static int comparePairs(const void* a, const void* b) {
+  const OpcodePair* left = a;
+  const OpcodePair* right = b;
+  if (left->count != right->count) return left->count < right->count ? 1 : -1;
+  return 0;
+}
+
+// executed opcodes, busiest first. returns how many
+static int sortOpcodes(uint8_t* opcodes) {
+  int count = 0;
+  for (int op = 0; op < OP_COUNT; op++) {
+    if (opcodeProfile.counts[op] > 0) opcodes[count++] = (uint8_t)op;
+  }
+  qsort(opcodes, count, sizeof(uint8_t), compareOpcodes);
+  return count;
+}
+
+// most frequent pairs first, at most PROFILE_TOP_PAIRS. returns how many
+static int sortPairs(OpcodePair* pairs) {
+  int count = 0;
+  for (int first = 0; first < OP_COUNT; first++) {
+    for (int second = 0; second < OP_COUNT; second++) {
+      uint64_t pairCount = opcodeProfile.pairs[first][second];
+      if (pairCount == 0) continue;
+      pairs[count++] = (OpcodePair){first, second, pairCount};
+    }
+  }
+  qsort(pairs, count, sizeof(OpcodePair), comparePairs);
+  return count < PROFILE_TOP_PAIRS ? count : PROFILE_TOP_PAIRS;
+}
+
+static void printText(FILE* out, uint8_t* opcodes, int opcodeCount,
+                      OpcodePair* pairs, int pairCount) {
+  uint64_t totalTicks = 0;
+  uint64_t totalCount = 0;
+  for (int i = 0; i < opcodeCount; i++) {
+    totalTicks += opcodeProfile.ticks[opcodes[i]];
+    totalCount += opcodeProfile.counts[opcodes[i]];
+  }
+
+  fprintf(out, "%-16s %12s %14s %7s %10s\n", "opcode", "count",
+          PROFILE_CLOCK_UNIT, "time", "per op");
+  for (int i = 0; i < opcodeCount; i++) {
+    uint8_t op = opcodes[i];
+    uint64_t count = opcodeProfile.counts[op];
+    uint64_t ticks = opcodeProfile.ticks[op];
+    fprintf(out, "%-16s %12llu %14llu %6.1f%% %10.1f\n", opcodeName(op),
+            (unsigned long long)count, (unsigned long long)ticks,
+            totalTicks == 0 ? 0.0 : 100.0 * ticks / totalTicks,
+            (double)ticks / count);
+  }
+  fprintf(out, "%-16s %12llu %14llu\n", "total",
+          (unsigned long long)totalCount, (unsigned long long)totalTicks);
+
+  if (pairCount == 0) return;
+  fprintf(out, "\n%-33s %12s\n", "opcode pair", "count");
+  for (int i = 0; i < pairCount; i++) {
+    fprintf(out, "%-16s %-16s %12llu\n", opcodeName(pairs[i].first),
+            opcodeName(pairs[i].second), (unsigned long long)pairs[i].count);
+  }
+}
+
+static void printJson(FILE* out, uint8_t* opcodes, int opcodeCount,
+                      OpcodePair* pairs, int pairCount) {
+  fprintf(out, "{\"unit\":\"%s\",\"opcodes\":[", PROFILE_CLOCK_UNIT);
+  for (int i = 0; i < opcodeCount; i++) {
+    uint8_t op = opcodes[i];
+    fprintf(out, "%s{\"name\":\"%s\",\"count\":%llu,\"ticks\":%llu}",
+            i > 0 ? "," : "", opcodeName(op),
+            (unsigned long long)opcodeProfile.counts[op],
+            (unsigned long long)opcodeProfile.ticks[op]);
+  }
+
+  fputs("],\"pairs\":[", out);
+  for (int i = 0; i < pairCount; i++) {
+    fprintf(out, "%s{\"first\":\"%s\",\"second\":\"%s\",\"count\":%llu}",
+            i > 0 ? "," : "", opcodeName(pairs[i].first),
+            opcodeName(pairs[i].second), (unsigned long long)pairs[i].count);
+  }
+  fputs("]}\n", out);
+}
+
+void printOpcodeProfile(FILE* out, bool asJson) {
+  uint8_t opcodes[OP_COUNT];
+  int opcodeCount = sortOpcodes(opcodes);
+  OpcodePair pairs[OP_COUNT * OP_COUNT];
+  int pairCount = sortPairs(pairs);
+
+  if (asJson) {
+    printJson(out, opcodes, opcodeCount, pairs, pairCount);
+  } else {
+    printText(out, opcodes, opcodeCount, pairs, pairCount);
+  }
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef clox_profile_h
+#define clox_profile_h
+
+#include "common.h"
+
+#ifdef PROFILE_OPCODES
+
+#include <stdio.h>
+
+#include "chunk.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+// per-opcode execution counts and time, plus counts of adjacent opcode
+// pairs (candidates for superinstructions). an opcode is charged the time
+// from its dispatch to the next one, so the cost of the dispatch itself is
+// included
+
+typedef struct {
+  uint64_t counts[OP_COUNT];
+  uint64_t ticks[OP_COUNT];
+  // pairs[a][b]: times b was dispatched right after a
+  uint64_t pairs[OP_COUNT][OP_COUNT];
+  // opcode being timed, or -1 outside run()
+  int current;
+  uint64_t start;
+} OpcodeProfile;
+
+extern OpcodeProfile opcodeProfile;
+
+// TSC cycles on x86, nanoseconds elsewhere
+static inline uint64_t profileClock() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static inline void profileInstruction(uint8_t instruction) {
+  uint64_t now = profileClock();
+  if (opcodeProfile.current >= 0) {
+    opcodeProfile.ticks[opcodeProfile.current] += now - opcodeProfile.start;
+    opcodeProfile.pairs[opcodeProfile.current][instruction]++;
+  }
+
+  opcodeProfile.counts[instruction]++;
+  opcodeProfile.current = instruction;
+  opcodeProfile.start = now;
+}
+
+// charges the last opcode of a run() and stops pairing across runs
+static inline void profileEnd() {
+  if (opcodeProfile.current >= 0) {
+    opcodeProfile.ticks[opcodeProfile.current] +=
+        profileClock() - opcodeProfile.start;
+  }
+  opcodeProfile.current = -1;
+}
+
+void initOpcodeProfile();
+// sorted by time spent, busiest first. as a JSON document when asJson
+void printOpcodeProfile(FILE* out, bool asJson);
+
+#endif
+
+#endif
@@ -0,0 +1,260 @@
+// sigaction() with SA_RESTART and setitimer() are XSI
+#define _XOPEN_SOURCE 700
+
+#include "sampler.h"
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "debug.h"
+
+typedef struct {
+  // EMPTY_LINE in unused slots
+  int line;
+  uint64_t counts[OP_COUNT];
+  uint64_t total;
+} LineSamples;
+
+#define EMPTY_LINE (-1)
+
+static bool isSampling = false;
+static int sampleHz = 0;
+
+// published to the signal handler by beginSampledRun(). NULL outside run()
+static _Atomic(uint8_t*) runningCode = NULL;
+static int runningCount = 0;
+_Atomic(uint8_t*) sampledIp = NULL;
+// samples per offset of the running chunk. kept across runs and all 0
+// between them, so a REPL line costs no allocation
+static atomic_uint* offsetCounts = NULL;
+static int offsetCapacity = 0;
+// samples that landed in the running chunk: most runs take none
+static atomic_uint runSamples = 0;
+// samples taken while compiling, collecting, freeing, etc.
+static atomic_ulong outsideRun = 0;
+
+// totals folded from every run so far, in an open addressing table keyed
+// by source line: its size follows the lines sampled, not the highest line
+// number. host-side bookkeeping, so it comes from malloc and not the VM's
+// allocator
+static LineSamples* lines = NULL;
+static int lineCount = 0;
+// 0 or a power of 2
+static int lineCapacity = 0;
+
+static void handleSample(int signal) {
+  (void)signal;
+  uint8_t* code = atomic_load_explicit(&runningCode, memory_order_acquire);
+  // the opcode being executed. not vm.ip, which run() may keep in a register
+  uint8_t* ip = atomic_load_explicit(&sampledIp, memory_order_relaxed);
+  if (code != NULL && ip >= code && ip < code + runningCount) {
+    atomic_fetch_add_explicit(&offsetCounts[ip - code], 1,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&runSamples, 1, memory_order_relaxed);
+  } else {
+    atomic_fetch_add_explicit(&outsideRun, 1, memory_order_relaxed);
+  }
+}
+
+bool startSampling(int hz) {
+  if (hz <= 0 || hz > 1000000) return false;
+
+  struct sigaction action;
+  action.sa_handler = handleSample;
+  sigemptyset(&action.sa_mask);
+  // the timer must not make the REPL's reads fail
+  action.sa_flags = SA_RESTART;
+  if (sigaction(SIGPROF, &action, NULL) != 0) return false;
+
+  // tv_usec must stay below a second: 1 Hz is {1, 0}, not {0, 1000000}
+  long periodUs = 1000000 / hz;
+  struct itimerval timer;
+  timer.it_interval.tv_sec = periodUs / 1000000;
+  timer.it_interval.tv_usec = periodUs % 1000000;
+  timer.it_value = timer.it_interval;
+  if (setitimer(ITIMER_PROF, &timer, NULL) != 0) return false;
+
+  isSampling = true;
+  sampleHz = hz;
+  return true;
+}
+
+void stopSampling() {
+  if (!isSampling) return;
+
+  struct itimerval timer = {{0, 0}, {0, 0}};
+  setitimer(ITIMER_PROF, &timer, NULL);
+  // a signal already on its way must not kill the process
+  signal(SIGPROF, SIG_IGN);
+  isSampling = false;
+}
+
+bool beginSampledRun(Chunk* chunk) {
+  if (!isSampling || chunk->count == 0) return false;
+
+  if (chunk->count > offsetCapacity) {
+    // the old counts are all 0: nothing to copy
+    atomic_uint* grown = calloc(chunk->count, sizeof(atomic_uint));
+    // no room to sample this run: its samples count as outside run()
+    if (grown == NULL) return false;
+    free(offsetCounts);
+    offsetCounts = grown;
+    offsetCapacity = chunk->count;
+  }
+
+  runningCount = chunk->count;
+  atomic_store_explicit(&sampledIp, NULL, memory_order_relaxed);
+  atomic_store_explicit(&runningCode, chunk->code, memory_order_release);
+  return true;
+}
+
+static LineSamples* findLine(LineSamples* table, int capacity, int line) {
+  uint32_t mask = (uint32_t)capacity - 1;
+  // Fibonacci hashing spreads consecutive lines apart
+  uint32_t index = ((uint32_t)line * 2654435769u) & mask;
+  while (table[index].line != EMPTY_LINE && table[index].line != line) {
+    index = (index + 1) & mask;
+  }
+  return &table[index];
+}
+
+static bool growLines() {
+  int capacity = lineCapacity < 64 ? 64 : lineCapacity * 2;
+  LineSamples* grown = malloc(sizeof(LineSamples) * capacity);
+  if (grown == NULL) return false;
+  for (int i = 0; i < capacity; i++) grown[i].line = EMPTY_LINE;
+
+  for (int i = 0; i < lineCapacity; i++) {
+    if (lines[i].line == EMPTY_LINE) continue;
+    *findLine(grown, capacity, lines[i].line) = lines[i];
+  }
+
+  free(lines);
+  lines = grown;
+  lineCapacity = capacity;
+  return true;
+}
+
+static void addLineSamples(int line, uint8_t instruction, uint64_t samples) {
+  if (line < 0 || instruction >= OP_COUNT) return;
+  // at most 3/4 full
+  if ((lineCount + 1) * 4 > lineCapacity * 3 && !growLines()) return;
+
+  LineSamples* entry = findLine(lines, lineCapacity, line);
+  if (entry->line == EMPTY_LINE) {
+    *entry = (LineSamples){.line = line};
+    lineCount++;
+  }
+  entry->counts[instruction] += samples;
+  entry->total += samples;
+}
+
+void endSampledRun(Chunk* chunk) {
+  if (atomic_load(&runningCode) == NULL) return;
+  atomic_store_explicit(&runningCode, NULL, memory_order_release);
+  atomic_store_explicit(&sampledIp, NULL, memory_order_relaxed);
+
+  runningCount = 0;
+  if (atomic_exchange(&runSamples, 0) == 0) return;
+
+  // run() publishes opcode offsets only, so every count is an instruction's
+  for (int offset = 0; offset < chunk->count; offset++) {
+    unsigned samples = atomic_exchange(&offsetCounts[offset], 0);
+    if (samples > 0) {
+      addLineSamples(chunk->lines[offset], chunk->code[offset], samples);
+    }
+  }
+}
+
+//---------- START REPORTS ------------//
+static uint8_t hottestOpcode(LineSamples* line) {
+  uint8_t hottest = 0;
+  for (int op = 1; op < OP_COUNT; op++) {
+    if (line->counts[op] > line->counts[hottest]) hottest = (uint8_t)op;
+  }
+  return hottest;
+}
+
+// hottest first
+static int compareTotals(const void* a, const void* b) {
+  const LineSamples* left = *(const LineSamples* const*)a;
+  const LineSamples* right = *(const LineSamples* const*)b;
+  if (left->total != right->total) return left->total < right->total ? 1 : -1;
+  return left->line - right->line;
+}
+
+static int compareLineNumbers(const void* a, const void* b) {
+  const LineSamples* left = *(const LineSamples* const*)a;
+  const LineSamples* right = *(const LineSamples* const*)b;
+  return left->line - right->line;
+}
+
+// the sampled lines in the given order. NULL if malloc fails
+static LineSamples** sortLines(int (*compare)(const void*, const void*)) {
+  LineSamples** sorted = malloc(sizeof(LineSamples*) * (lineCount + 1));
+  if (sorted == NULL) return NULL;
+
+  int count = 0;
+  for (int i = 0; i < lineCapacity; i++) {
+    if (lines[i].line != EMPTY_LINE) sorted[count++] = &lines[i];
+  }
+  qsort(sorted, count, sizeof(LineSamples*), compare);
+  return sorted;
+}
+
+void printSampleReport(FILE* out) {
+  LineSamples** sorted = sortLines(compareTotals);
+  if (sorted == NULL) return;
+
+  uint64_t inRun = 0;
+  for (int i = 0; i < lineCount; i++) inRun += sorted[i]->total;
+
+  uint64_t total = inRun + atomic_load(&outsideRun);
+  fprintf(out, "%llu samples at %d Hz, %llu outside run()\n",
+          (unsigned long long)total, sampleHz,
+          (unsigned long long)atomic_load(&outsideRun));
+  fprintf(out, "%8s %10s %7s  %s\n", "line", "samples", "share",
+          "hottest opcode");
+  for (int i = 0; i < lineCount; i++) {
+    LineSamples* line = sorted[i];
+    fprintf(out, "%8d %10llu %6.1f%%  %s\n", line->line,
+            (unsigned long long)line->total, 100.0 * line->total / total,
+            opcodeName(hottestOpcode(line)));
+  }
+
+  free(sorted);
+}
+
+void writeFoldedStacks(FILE* out) {
+  LineSamples** sorted = sortLines(compareLineNumbers);
+  if (sorted == NULL) return;
+
+  for (int i = 0; i < lineCount; i++) {
+    LineSamples* line = sorted[i];
+    for (int op = 0; op < OP_COUNT; op++) {
+      if (line->counts[op] == 0) continue;
+      fprintf(out, "script;line %d;%s %llu\n", line->line,
+              opcodeName((uint8_t)op), (unsigned long long)line->counts[op]);
+    }
+  }
+  free(sorted);
+
+  uint64_t outside = atomic_load(&outsideRun);
+  if (outside > 0) {
+    fprintf(out, "script;(outside run) %llu\n", (unsigned long long)outside);
+  }
+}
+//---------- END REPORTS ------------//
+
+void freeSamples() {
+  free(offsetCounts);
+  offsetCounts = NULL;
+  offsetCapacity = 0;
+  free(lines);
+  lines = NULL;
+  lineCount = 0;
+  lineCapacity = 0;
+  atomic_store(&outsideRun, 0);
+}
@@ -2,6 +2,12 @@
 
 #include <string.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "common.h"
 
 typedef struct {
@@ -63,6 +69,203 @@ static Token errorToken(const char* msg) {
 }
 //-------- END TOKEN UTILS ----------//
 
+//-------- START RUN SCANNING --------//
+// each function returns the end of a run of bytes starting at p, which is
+// never past the source's terminating '\0'. the ones that cross lines add
+// the newlines they pass to *lines
+
+static inline bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline bool isIdentifierChar(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+// most runs are short (one space, a 3-digit number), and finishing those
+// byte by byte beats setting up a block. runs that outlast this many bytes
+// switch to blocks. comment and string bodies are rarely short enough to
+// bother
+#define SCALAR_PREFIX 8
+
+// blocks are loaded aligned, so a load never crosses into the next page and
+// can't fault past the end of the source. the bytes it reads past the '\0'
+// are ignored, but ASan can't tell
+#define NO_ASAN __attribute__((no_sanitize_address))
+
+#ifdef __AVX2__
+#define SCAN_BLOCK 32
+typedef __m256i Block;
+
+static inline NO_ASAN Block loadBlock(const char* p) {
+  return _mm256_load_si256((const __m256i*)p);
+}
+static inline uint32_t matchChar(Block block, char c) {
+  return (uint32_t)_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(block, _mm256_set1_epi8(c)));
+}
+// bytes in [low, high]. both must be below 0x80
+static inline uint32_t matchRange(Block block, char low, char high) {
+  __m256i above = _mm256_cmpgt_epi8(block, _mm256_set1_epi8(low - 1));
+  __m256i below = _mm256_cmpgt_epi8(_mm256_set1_epi8(high + 1), block);
+  return (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(above, below));
+}
+static inline Block toLower(Block block) {
+  return _mm256_or_si256(block, _mm256_set1_epi8(0x20));
+}
+#define BLOCK_MASK 0xFFFFFFFFu
+#else
+#define SCAN_BLOCK 16
+typedef __m128i Block;
+
+static inline NO_ASAN Block loadBlock(const char* p) {
+  return _mm_load_si128((const __m128i*)p);
+}
+static inline uint32_t matchChar(Block block, char c) {
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c)));
+}
+static inline uint32_t matchRange(Block block, char low, char high) {
+  __m128i above = _mm_cmpgt_epi8(block, _mm_set1_epi8(low - 1));
+  __m128i below = _mm_cmpgt_epi8(_mm_set1_epi8(high + 1), block);
+  return (uint32_t)_mm_movemask_epi8(_mm_and_si128(above, below));
+}
+static inline Block toLower(Block block) {
+  return _mm_or_si128(block, _mm_set1_epi8(0x20));
+}
+#define BLOCK_MASK 0xFFFFu
+#endif
+
+// the stop functions flag the bytes that end a run. '\0' always does
+static inline uint32_t stopSpace(Block block) {
+  uint32_t spaces = matchChar(block, ' ') | matchChar(block, '\t') |
+                    matchChar(block, '\r') | matchChar(block, '\n');
+  return ~spaces & BLOCK_MASK;
+}
+
+static inline uint32_t stopIdentifier(Block block) {
+  // or-ing in 0x20 folds A-Z onto a-z and nothing else onto it
+  uint32_t chars = matchRange(toLower(block), 'a', 'z') |
+                   matchRange(block, '0', '9') | matchChar(block, '_');
+  return ~chars & BLOCK_MASK;
+}
+
+static inline uint32_t stopDigit(Block block) {
+  return ~matchRange(block, '0', '9') & BLOCK_MASK;
+}
+
+static inline uint32_t stopLineEnd(Block block) {
+  return matchChar(block, '\n') | matchChar(block, '\0');
+}
+
+static inline uint32_t stopQuote(Block block) {
+  return matchChar(block, '"') | matchChar(block, '\0');
+}
+
+static inline __attribute__((always_inline)) NO_ASAN const char* scanRun(
+    const char* p, uint32_t (*stops)(Block), int* lines) {
+  uintptr_t offset = (uintptr_t)p & (SCAN_BLOCK - 1);
+  const char* block = p - offset;
+  // the first block starts before p. its leading bytes are masked off
+  uint32_t live = (BLOCK_MASK << offset) & BLOCK_MASK;
+
+  for (;;) {
+    Block bytes = loadBlock(block);
+    uint32_t stop = stops(bytes) & live;
+    if (lines != NULL) {
+      uint32_t newlines = matchChar(bytes, '\n') & live;
+      if (stop != 0) newlines &= (stop & -stop) - 1;
+      *lines += __builtin_popcount(newlines);
+    }
+    if (stop != 0) return block + __builtin_ctz(stop);
+
+    block += SCAN_BLOCK;
+    live = BLOCK_MASK;
+  }
+}
+
+// the block loops are kept out of line. inlined, they bloat scanToken()
+// and slow down the short tokens that never reach them
+#define BLOCK_LOOP __attribute__((noinline)) NO_ASAN
+
+static BLOCK_LOOP const char* spaceBlocks(const char* p, int* lines) {
+  return scanRun(p, stopSpace, lines);
+}
+
+static BLOCK_LOOP const char* identifierBlocks(const char* p) {
+  return scanRun(p, stopIdentifier, NULL);
+}
+
+static BLOCK_LOOP const char* digitBlocks(const char* p) {
+  return scanRun(p, stopDigit, NULL);
+}
+
+static BLOCK_LOOP const char* findLineEnd(const char* p) {
+  return scanRun(p, stopLineEnd, NULL);
+}
+
+static BLOCK_LOOP const char* findStringEnd(const char* p, int* lines) {
+  return scanRun(p, stopQuote, lines);
+}
+
+static inline const char* skipSpaceRun(const char* p, int* lines) {
+  for (int i = 0; i < SCALAR_PREFIX; i++, p++) {
+    if (!isSpace(*p)) return p;
+    if (*p == '\n') (*lines)++;
+  }
+  return spaceBlocks(p, lines);
+}
+
+static inline const char* skipIdentifierRun(const char* p) {
+  for (int i = 0; i < SCALAR_PREFIX; i++, p++) {
+    if (!isIdentifierChar(*p)) return p;
+  }
+  return identifierBlocks(p);
+}
+
+static inline const char* skipDigitRun(const char* p) {
+  for (int i = 0; i < SCALAR_PREFIX; i++, p++) {
+    if (*p < '0' || *p > '9') return p;
+  }
+  return digitBlocks(p);
+}
+
+#else
+
+static inline const char* skipSpaceRun(const char* p, int* lines) {
+  for (; isSpace(*p); p++) {
+    if (*p == '\n') (*lines)++;
+  }
+  return p;
+}
+
+static inline const char* skipIdentifierRun(const char* p) {
+  while (isIdentifierChar(*p)) p++;
+  return p;
+}
+
+static inline const char* skipDigitRun(const char* p) {
+  while (*p >= '0' && *p <= '9') p++;
+  return p;
+}
+
+static inline const char* findLineEnd(const char* p) {
+  while (*p != '\n' && *p != '\0') p++;
+  return p;
+}
+
+static inline const char* findStringEnd(const char* p, int* lines) {
+  for (; *p != '"' && *p != '\0'; p++) {
+    if (*p == '\n') (*lines)++;
+  }
+  return p;
+}
+
+#endif
+//-------- END RUN SCANNING --------//
+
 //-------- START SCANNING UTILS --------//
 static void skipWhitespace() {
   for (;;) {
@@ -72,18 +275,13 @@ static void skipWhitespace() {
       case ' ':
       case '\r':
       case '\t':
-        advance();
-        break;
       case '\n':
-        advance();
-        scanner.line++;
+        scanner.current = skipSpaceRun(scanner.current, &scanner.line);
         break;
 
       case '/':
         if (peekNext() == '/') {
-          while (peek() != '\n' && !isAtEnd()) {
-            advance();
-          }
+          scanner.current = findLineEnd(scanner.current);
         } else {
           return;
         }
@@ -96,10 +294,7 @@ static void skipWhitespace() {
 }
 
 static Token string() {
-  while (peek() != '"' && !isAtEnd()) {
-    if (peek() == '\n') scanner.line++;
-    advance();
-  }
+  scanner.current = findStringEnd(scanner.current, &scanner.line);
 
   if (isAtEnd()) return errorToken("Unterminated string.");
 
@@ -111,17 +306,13 @@ static Token string() {
 static bool isDigit(char c) { return c >= '0' && c <= '9'; }
 
 static Token number() {
-  while (isDigit(peek())) {
-    advance();
-  }
+  scanner.current = skipDigitRun(scanner.current);
 
   if (peek() == '.' && isDigit(peekNext())) {
     // consume decimal point '.'
     advance();
 
-    while (isDigit(peek())) {
-      advance();
-    }
+    scanner.current = skipDigitRun(scanner.current);
   }
 
   return makeToken(TOKEN_NUMBER);
@@ -131,76 +322,70 @@ static bool isAlpha(char c) {
   return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
 }
 
-static TokenType checkKeyword(int start, int length, const char* rest,
-                              TokenType type) {
-  // lexeme = scanner.start --- start --- start + length (scanner.current)
-  bool isCorrectLength = scanner.current - scanner.start == start + length;
-  bool areCharsMatched = memcmp(scanner.start + start, rest, length) == 0;
-
-  if (isCorrectLength && areCharsMatched) return type;
-
-  return TOKEN_IDENTIFIER;
-}
+//-------- START KEYWORDS --------//
+typedef struct {
+  const char* name;
+  int length;
+  TokenType type;
+} Keyword;
+
+// a perfect hash of the keywords: no two share a slot, so one comparison
+// tells a keyword from an identifier
+#define KEYWORD_SLOTS 32
+#define KEYWORD_HASH(first, last, length) \
+  (((unsigned)(first) + (unsigned)(last)*5 + (unsigned)(length)) & \
+   (KEYWORD_SLOTS - 1))
+// C can't index a string literal in a constant expression, so the first
+// and last chars are spelled out
+#define KEYWORD(name, first, last, type)                      \
+  [KEYWORD_HASH(first, last, sizeof(name) - 1)] = {name, sizeof(name) - 1, \
+                                                   type}
+
+#define KEYWORD_MIN_LENGTH 2
+#define KEYWORD_MAX_LENGTH 6
+
+static const Keyword keywords[KEYWORD_SLOTS] = {
+    KEYWORD("and", 'a', 'd', TOKEN_AND),
+    KEYWORD("class", 'c', 's', TOKEN_CLASS),
+    KEYWORD("else", 'e', 'e', TOKEN_ELSE),
+    KEYWORD("false", 'f', 'e', TOKEN_FALSE),
+    KEYWORD("for", 'f', 'r', TOKEN_FOR),
+    KEYWORD("fun", 'f', 'n', TOKEN_FUN),
+    KEYWORD("if", 'i', 'f', TOKEN_IF),
+    KEYWORD("nil", 'n', 'l', TOKEN_NIL),
+    KEYWORD("or", 'o', 'r', TOKEN_OR),
+    KEYWORD("print", 'p', 't', TOKEN_PRINT),
+    KEYWORD("return", 'r', 'n', TOKEN_RETURN),
+    KEYWORD("super", 's', 'r', TOKEN_SUPER),
+    KEYWORD("this", 't', 's', TOKEN_THIS),
+    KEYWORD("true", 't', 'e', TOKEN_TRUE),
+    KEYWORD("var", 'v', 'r', TOKEN_VAR),
+    KEYWORD("while", 'w', 'e', TOKEN_WHILE),
+};
 
 static TokenType identifierType() {
-  switch (scanner.start[0]) {
-    case 'a':
-      return checkKeyword(1, 2, "nd", TOKEN_AND);
-    case 'c':
-      return checkKeyword(1, 4, "lass", TOKEN_CLASS);
-    case 'e':
-      return checkKeyword(1, 3, "lse", TOKEN_ELSE);
-    case 'i':
-      return checkKeyword(1, 1, "f", TOKEN_IF);
-    case 'n':
-      return checkKeyword(1, 2, "il", TOKEN_NIL);
-    case 'o':
-      return checkKeyword(1, 1, "r", TOKEN_OR);
-    case 'p':
-      return checkKeyword(1, 4, "rint", TOKEN_PRINT);
-    case 'r':
-      return checkKeyword(1, 5, "eturn", TOKEN_RETURN);
-    case 's':
-      return checkKeyword(1, 4, "uper", TOKEN_SUPER);
-    case 'v':
-      return checkKeyword(1, 2, "ar", TOKEN_VAR);
-    case 'w':
-      return checkKeyword(1, 4, "hile", TOKEN_WHILE);
-    case 'f':
-      // match 2nd char in trie branch (if exists)
-      if (scanner.current - scanner.start > 1) {
-        switch (scanner.start[1]) {
-          case 'a':
-            return checkKeyword(2, 3, "lse", TOKEN_FALSE);
-          case 'o':
-            return checkKeyword(2, 1, "r", TOKEN_FOR);
-          case 'u':
-            return checkKeyword(2, 1, "n", TOKEN_FUN);
-        }
-      }
-      // fall-through : 'f' is a valid identifier
-      break;
-    case 't':
-      if (scanner.current - scanner.start > 1) {
-        switch (scanner.start[1]) {
-          case 'h':
-            return checkKeyword(2, 2, "is", TOKEN_THIS);
-          case 'r':
-            return checkKeyword(2, 2, "ue", TOKEN_TRUE);
-        }
-      }
-      // fall-through : 't' is a valid identifier
-      break;
+  int length = (int)(scanner.current - scanner.start);
+  if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH) {
+    return TOKEN_IDENTIFIER;
   }
 
-  return TOKEN_IDENTIFIER;
+  const Keyword* keyword = &keywords[KEYWORD_HASH(
+      (unsigned char)scanner.start[0],
+      (unsigned char)scanner.start[length - 1], length)];
+  // empty slots have length 0, so they never match
+  if (keyword->length != length) return TOKEN_IDENTIFIER;
+
+  // a loop over at most 6 chars beats calling memcmp
+  for (int i = 0; i < length; i++) {
+    if (scanner.start[i] != keyword->name[i]) return TOKEN_IDENTIFIER;
+  }
+  return keyword->type;
 }
+//-------- END KEYWORDS --------//
 
 static Token identifier() {
   // note: after the 1st alphanum char, other chars can be digits
-  while (isAlpha(peek()) || isDigit(peek())) {
-    advance();
-  }
+  scanner.current = skipIdentifierRun(scanner.current);
 
   return makeToken(identifierType());
 }
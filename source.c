@@ -0,0 +1,114 @@
+// MAP_ANONYMOUS and madvise() aren't in strict POSIX
+#define _DEFAULT_SOURCE
+
+#include "source.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// streams are read this much at a time, into a buffer that doubles
+#define STREAM_CHUNK_SIZE (64 * 1024)
+
+// maps the file with at least one zero byte after it, so the view is a
+// '\0'-terminated string without a copy. the page cache is shared rather
+// than duplicated into the heap
+static bool mapFile(Source* source, int fd, size_t length) {
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  // length + 1 bytes, rounded up to whole pages
+  size_t size = (length + pageSize) & ~(pageSize - 1);
+
+  // zero pages first, then the file over their start. the end of the
+  // file's last page and the pages after it read as zeros
+  char* base =
+      mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) return false;
+  if (mmap(base, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+      MAP_FAILED) {
+    munmap(base, size);
+    return false;
+  }
+  // the scanner reads front to back
+  madvise(base, length, MADV_SEQUENTIAL);
+
+  source->chars = base;
+  source->length = length;
+  source->storage = SOURCE_MAPPED;
+  source->size = size;
+  return true;
+}
+
+static SourceResult readStream(Source* source, int fd) {
+  size_t capacity = STREAM_CHUNK_SIZE;
+  size_t length = 0;
+  char* buffer = malloc(capacity);
+  if (buffer == NULL) return SOURCE_NO_MEMORY;
+
+  for (;;) {
+    // room for a whole chunk and the '\0'
+    if (capacity - length < STREAM_CHUNK_SIZE + 1) {
+      capacity *= 2;
+      char* grown = realloc(buffer, capacity);
+      if (grown == NULL) {
+        free(buffer);
+        return SOURCE_NO_MEMORY;
+      }
+      buffer = grown;
+    }
+
+    ssize_t bytesRead = read(fd, buffer + length, STREAM_CHUNK_SIZE);
+    if (bytesRead == 0) break;
+    if (bytesRead < 0) {
+      if (errno == EINTR) continue;
+      free(buffer);
+      return SOURCE_CANT_READ;
+    }
+    length += (size_t)bytesRead;
+  }
+
+  buffer[length] = '\0';
+  source->chars = buffer;
+  source->length = length;
+  source->storage = SOURCE_READ;
+  source->size = capacity;
+  return SOURCE_OK;
+}
+
+SourceResult loadSource(Source* source, const char* path) {
+  if (strcmp(path, "-") == 0) return readStream(source, STDIN_FILENO);
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return SOURCE_CANT_OPEN;
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    close(fd);
+    return SOURCE_CANT_READ;
+  }
+
+  // empty files can't be mapped, and some filesystems can't map at all.
+  // both fall back to reading
+  SourceResult result = SOURCE_OK;
+  if (!S_ISREG(info.st_mode) || info.st_size == 0 ||
+      !mapFile(source, fd, (size_t)info.st_size)) {
+    result = readStream(source, fd);
+  }
+
+  // a mapping outlives its descriptor
+  close(fd);
+  return result;
+}
+
+void freeSource(Source* source) {
+  if (source->storage == SOURCE_MAPPED) {
+    munmap((void*)source->chars, source->size);
+  } else {
+    free((void*)source->chars);
+  }
+  source->chars = NULL;
+  source->length = 0;
+}
@@ -0,0 +1,33 @@
+#ifndef clox_source_h
+#define clox_source_h
+
+#include "common.h"
+
+// a script's text, loaded for interpret(). regular files are mapped
+// rather than copied; pipes and other streams are read in chunks
+typedef enum {
+  SOURCE_MAPPED,
+  SOURCE_READ
+} SourceStorage;
+
+typedef struct {
+  // always '\0'-terminated
+  const char* chars;
+  size_t length;
+  SourceStorage storage;
+  // bytes mapped or allocated, which is more than length
+  size_t size;
+} Source;
+
+typedef enum {
+  SOURCE_OK,
+  SOURCE_CANT_OPEN,
+  SOURCE_CANT_READ,
+  SOURCE_NO_MEMORY
+} SourceResult;
+
+// path "-" reads standard input
+SourceResult loadSource(Source* source, const char* path);
+void freeSource(Source* source);
+
+#endif
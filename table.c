@@ -2,98 +2,395 @@
 
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "memory.h"
 #include "object.h"
 #include "value.h"
 
+// control byte values. a full slot stores the low 7 bits of its key's hash
+// (0..127), so the high bit alone tells free slots from full ones
+#define CONTROL_EMPTY ((uint8_t)0x80)
+#define CONTROL_DELETED ((uint8_t)0xFE)
+
+#define TABLE_MIN_CAPACITY TABLE_GROUP_WIDTH
+
+// hash bits 0-6 are stored in the control byte, the rest pick the group
+#define HASH_FRAGMENT(hash) ((uint8_t)((hash)&0x7F))
+#define HASH_POSITION(hash) ((hash) >> 7)
+
+static inline bool isFull(uint8_t control) { return control < 0x80; }
+
+//---------- START GROUP MATCHING ------------//
+// each function returns a bitmask with bit i set if slot i of the group
+// (16 control bytes) matches
+
+static inline uint32_t matchByte(const uint8_t* group, uint8_t value) {
+#ifdef __SSE2__
+  __m128i control = _mm_loadu_si128((const __m128i*)group);
+  __m128i matches = _mm_cmpeq_epi8(control, _mm_set1_epi8((char)value));
+  return (uint32_t)_mm_movemask_epi8(matches);
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < TABLE_GROUP_WIDTH; i++) {
+    if (group[i] == value) mask |= 1u << i;
+  }
+  return mask;
+#endif
+}
+
+// empty or deleted slots
+static inline uint32_t matchFree(const uint8_t* group) {
+#ifdef __SSE2__
+  // the high bit of each byte is exactly the "free" flag
+  __m128i control = _mm_loadu_si128((const __m128i*)group);
+  return (uint32_t)_mm_movemask_epi8(control);
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < TABLE_GROUP_WIDTH; i++) {
+    if (!isFull(group[i])) mask |= 1u << i;
+  }
+  return mask;
+#endif
+}
+
+static inline int lowestBit(uint32_t mask) { return __builtin_ctz(mask); }
+//---------- END GROUP MATCHING ------------//
+
+// entries and control bytes share one allocation (control bytes last), so
+// a resize either gets both or fails without leaking either
+#define SLOTS_SIZE(capacity) ((size_t)(capacity) * (sizeof(Entry) + 1))
+
+static Entry* allocateSlots(int capacity, uint8_t** controls) {
+  Entry* entries = (Entry*)reallocate(NULL, 0, SLOTS_SIZE(capacity));
+  *controls = (uint8_t*)(entries + capacity);
+  memset(*controls, CONTROL_EMPTY, capacity);
+  return entries;
+}
+
+static void freeSlots(Entry* entries, int capacity) {
+  reallocate(entries, SLOTS_SIZE(capacity), 0);
+}
+
 void initTable(Table* table) {
   table->count = 0;
+  table->tombstones = 0;
   table->capacity = 0;
+  table->control = NULL;
   table->entries = NULL;
+  table->isIncremental = false;
+  table->oldCount = 0;
+  table->oldCapacity = 0;
+  table->migrateIndex = 0;
+  table->oldControl = NULL;
+  table->oldEntries = NULL;
+  table->metrics = NULL;
+}
+
+static void freeOldArrays(Table* table) {
+  freeSlots(table->oldEntries, table->oldCapacity);
+  table->oldCount = 0;
+  table->oldCapacity = 0;
+  table->migrateIndex = 0;
+  table->oldControl = NULL;
+  table->oldEntries = NULL;
+}
+
+size_t tableBytes(Table* table) {
+  return SLOTS_SIZE(table->capacity) + SLOTS_SIZE(table->oldCapacity);
 }
 
 void freeTable(Table* table) {
-  FREE_ARRAY(Entry, table->entries, table->capacity);
+  freeOldArrays(table);
+  freeSlots(table->entries, table->capacity);
+
+  bool isIncremental = table->isIncremental;
+  Metrics* metrics = table->metrics;
   initTable(table);
+  table->isIncremental = isIncremental;
+  table->metrics = metrics;
+}
+
+// groups are probed triangularly (offsets 0, 1, 3, 6... groups), which
+// visits every group since the group count is a power of 2
+#define NEXT_GROUP(group, stride, mask)      \
+  do {                                       \
+    (stride) += TABLE_GROUP_WIDTH;           \
+    (group) = ((group) + (stride)) & (mask); \
+  } while (false)
+
+static inline size_t firstGroup(uint32_t hash, int capacity) {
+  return HASH_POSITION(hash) & (size_t)(capacity - 1) &
+         ~(size_t)(TABLE_GROUP_WIDTH - 1);
+}
+
+// one sample per lookup, summing the groups probed in both arrays mid-resize
+static inline void recordProbeLength(Metrics* metrics, int groups) {
+  if (metrics == NULL || groups == 0) return;
+  metrics->counters[METRIC_TABLE_LOOKUPS]++;
+  int bucket =
+      groups < PROBE_HISTOGRAM_SIZE ? groups - 1 : PROBE_HISTOGRAM_SIZE - 1;
+  metrics->probeLengths[bucket]++;
 }
 
-static Entry* findEntry(Entry* entries, int capacity, ObjString* key) {
-  uint32_t index = key->hash % capacity;
-  Entry* tombstone = NULL;
+// the probing helpers take the arrays explicitly, since during an
+// incremental resize both the old and new ones are searched
+
+// returns the slot holding key, or -1. adds the groups it probed to *groups
+static int findSlot(const uint8_t* controls, Entry* entries, int capacity,
+                    ObjString* key, uint32_t hash, int* groups) {
+  if (capacity == 0) return -1;
+
+  uint8_t fragment = HASH_FRAGMENT(hash);
+  size_t mask = (size_t)capacity - 1;
+  size_t group = firstGroup(hash, capacity);
+  size_t stride = 0;
 
   for (;;) {
-    Entry* entry = &entries[index];
-    // Current tombstone definition: NULL key and non-nil value
-    bool isTombstone = entry->key == NULL && !IS_NIL(entry->value);
-
-    if (tombstone == NULL && isTombstone) {
-      tombstone = entry;
-    } else if (entry->key == NULL) {
-      // reached an empty bucket
-      return tombstone == NULL ? entry : tombstone;
+    (*groups)++;
+    const uint8_t* control = &controls[group];
+
+    uint32_t matches = matchByte(control, fragment);
+    while (matches != 0) {
+      size_t slot = group + lowestBit(matches);
+      if (entries[slot].key == key) return (int)slot;
+      matches &= matches - 1;
     }
 
-    if (entry->key == key) {
-      return entry;
+    // an empty slot ends the probe sequence: the key would have been put
+    // there. deleted slots don't, since probing went past them on insert
+    if (matchByte(control, CONTROL_EMPTY) != 0) return -1;
+
+    NEXT_GROUP(group, stride, mask);
+  }
+}
+
+// first free slot on key's probe sequence. the table must have one
+static size_t findFreeSlot(uint8_t* controls, int capacity, uint32_t hash) {
+  size_t mask = (size_t)capacity - 1;
+  size_t group = firstGroup(hash, capacity);
+  size_t stride = 0;
+
+  for (;;) {
+    uint32_t free = matchFree(&controls[group]);
+    if (free != 0) return group + lowestBit(free);
+
+    NEXT_GROUP(group, stride, mask);
+  }
+}
+
+static ObjString* findString(const uint8_t* controls, Entry* entries,
+                             int capacity, const char* chars, int length,
+                             uint32_t hash, int* groups) {
+  if (capacity == 0) return NULL;
+
+  uint8_t fragment = HASH_FRAGMENT(hash);
+  size_t mask = (size_t)capacity - 1;
+  size_t group = firstGroup(hash, capacity);
+  size_t stride = 0;
+
+  for (;;) {
+    (*groups)++;
+    const uint8_t* control = &controls[group];
+
+    // the fragment filters out ~127/128 of non-matching keys without
+    // touching them
+    uint32_t matches = matchByte(control, fragment);
+    while (matches != 0) {
+      ObjString* key = entries[group + lowestBit(matches)].key;
+      if (key->length == length && key->hash == hash &&
+          memcmp(key->chars, chars, length) == 0) {
+        return key;
+      }
+      matches &= matches - 1;
     }
 
-    index = (index + 1) % capacity;
+    if (matchByte(control, CONTROL_EMPTY) != 0) return NULL;
+
+    NEXT_GROUP(group, stride, mask);
   }
 }
 
-static void adjustCapacity(Table* table, int capacity) {
-  Entry* entries = ALLOCATE(Entry, capacity);
-  for (int i = 0; i < capacity; i++) {
-    entries[i].key = NULL;
-    entries[i].value = NIL_VAL();
+// moves an entry known not to be in the table into a free slot. returns
+// true when that slot was a tombstone, which the caller stops counting
+static bool insertEntry(uint8_t* controls, Entry* entries, int capacity,
+                        Entry* entry) {
+  uint32_t hash = entry->key->hash;
+  size_t slot = findFreeSlot(controls, capacity, hash);
+  bool wasDeleted = controls[slot] == CONTROL_DELETED;
+  controls[slot] = HASH_FRAGMENT(hash);
+  entries[slot] = *entry;
+  return wasDeleted;
+}
+
+//---------- START RESIZING ------------//
+static inline bool isResizing(Table* table) { return table->oldCapacity > 0; }
+
+static void migrateBuckets(Table* table, int bucketCount) {
+  int end = table->migrateIndex + bucketCount;
+  if (end > table->oldCapacity) end = table->oldCapacity;
+
+  for (int i = table->migrateIndex; i < end; i++) {
+    if (!isFull(table->oldControl[i])) continue;
+
+    // deletes during the migration leave tombstones in the new arrays
+    if (insertEntry(table->control, table->entries, table->capacity,
+                    &table->oldEntries[i])) {
+      table->tombstones--;
+    }
+    // keeps probe sequences through this bucket intact for old lookups
+    table->oldControl[i] = CONTROL_DELETED;
+    table->oldCount--;
   }
 
-  // reset table count to exclude tombstones
-  table->count = 0;
+  table->migrateIndex = end;
+  if (table->migrateIndex == table->oldCapacity) freeOldArrays(table);
+}
 
-  for (int i = 0; i < table->capacity; i++) {
-    Entry* entry = &table->entries[i];
-    if (entry->key == NULL) continue;
+// the bounded amount of resize work each table operation pays for
+static inline void migrateStep(Table* table) {
+  if (isResizing(table)) migrateBuckets(table, TABLE_MIGRATE_BUCKETS);
+}
+
+static void finishResize(Table* table) {
+  if (isResizing(table)) migrateBuckets(table, table->oldCapacity);
+}
 
-    Entry* newEntry = findEntry(entries, capacity, entry->key);
-    newEntry->key = entry->key;
-    newEntry->value = entry->value;
-    table->count++;
+// rehashes into fresh arrays, which also drops every tombstone
+static void adjustCapacity(Table* table, int capacity) {
+  uint8_t* controls;
+  Entry* entries = allocateSlots(capacity, &controls);
+
+  for (int i = 0; i < table->capacity; i++) {
+    // fresh arrays have no tombstones to reuse
+    if (!isFull(table->control[i])) continue;
+    insertEntry(controls, entries, capacity, &table->entries[i]);
   }
 
-  FREE_ARRAY(Entry, table->entries, table->capacity);
+  freeSlots(table->entries, table->capacity);
+  table->control = controls;
+  table->entries = entries;
   table->capacity = capacity;
+  table->tombstones = 0;
+}
+
+// the current arrays become the old ones, to be drained by migrateStep
+static void beginResize(Table* table, int capacity) {
+  uint8_t* controls;
+  Entry* entries = allocateSlots(capacity, &controls);
+
+  table->oldControl = table->control;
+  table->oldEntries = table->entries;
+  table->oldCapacity = table->capacity;
+  table->oldCount = table->count;
+  table->migrateIndex = 0;
+
+  table->control = controls;
   table->entries = entries;
+  table->capacity = capacity;
+  table->tombstones = 0;
 }
 
-bool tableSet(Table* table, ObjString* key, Value value) {
-  if (table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
-    int newCapacity = GROW_CAPACITY(table->capacity);
-    adjustCapacity(table, newCapacity);
+static void resize(Table* table, int capacity) {
+  if (table->metrics != NULL) {
+    table->metrics->counters[METRIC_TABLE_RESIZES]++;
   }
+  finishResize(table);
 
-  Entry* entry = findEntry(table->entries, table->capacity, key);
+  if (table->isIncremental && table->count >= TABLE_INCREMENTAL_MIN_COUNT) {
+    beginResize(table, capacity);
+  } else {
+    adjustCapacity(table, capacity);
+  }
+}
+
+// smallest capacity that holds count entries at half the max load, so a
+// freshly resized table has room to grow before the next resize
+static int capacityFor(int count) {
+  int capacity = TABLE_MIN_CAPACITY;
+  while (count > capacity * TABLE_MAX_LOAD / 2) capacity *= 2;
+  return capacity;
+}
+//---------- END RESIZING ------------//
+
+// looks key up in the new slots, then mid-resize in the old ones, which
+// *isOld tells apart. returns the slot or -1
+static int findEntry(Table* table, ObjString* key, uint32_t hash,
+                     bool* isOld) {
+  int groups = 0;
+  *isOld = false;
+  int slot = findSlot(table->control, table->entries, table->capacity, key,
+                      hash, &groups);
+  if (slot == -1) {
+    *isOld = true;
+    slot = findSlot(table->oldControl, table->oldEntries, table->oldCapacity,
+                    key, hash, &groups);
+  }
+  recordProbeLength(table->metrics, groups);
+  return slot;
+}
 
-  bool isNewKey = entry->key == NULL;
-  // only increment count if not tombstone
-  if (isNewKey && IS_NIL(entry->value)) {
-    table->count++;
+bool tableSet(Table* table, ObjString* key, Value value) {
+  uint32_t hash = stringHash(key);
+  migrateStep(table);
+
+  bool isOld;
+  int slot = findEntry(table, key, hash, &isOld);
+  if (slot != -1) {
+    // not migrated yet: update it where it is
+    Entry* entries = isOld ? table->oldEntries : table->entries;
+    entries[slot].value = value;
+    return false;
+  }
+
+  int newCount = table->count - table->oldCount;
+  if (newCount + table->tombstones + 1 > table->capacity * TABLE_MAX_LOAD) {
+    // when enough of the load is tombstones, this rehashes at the same
+    // capacity, which reclaims them instead of growing
+    int capacity = capacityFor(table->count + 1);
+    if (capacity < table->capacity) capacity = table->capacity;
+    resize(table, capacity);
   }
 
-  entry->key = key;
-  entry->value = value;
-  return isNewKey;
+  slot = (int)findFreeSlot(table->control, table->capacity, hash);
+  if (table->control[slot] == CONTROL_DELETED) table->tombstones--;
+
+  table->control[slot] = HASH_FRAGMENT(hash);
+  table->entries[slot].key = key;
+  table->entries[slot].value = value;
+  table->count++;
+  return true;
 }
 
 bool tableDelete(Table* table, ObjString* key) {
   if (table->count == 0) return false;
 
-  Entry* entry = findEntry(table->entries, table->capacity, key);
-  if (entry->key == NULL) return false;
+  uint32_t hash = stringHash(key);
+  migrateStep(table);
+
+  bool isOld;
+  int slot = findEntry(table, key, hash, &isOld);
+  if (slot == -1) return false;
+
+  if (!isOld) {
+    table->control[slot] = CONTROL_DELETED;
+    table->entries[slot].key = NULL;
+    table->tombstones++;
+  } else {
+    table->oldControl[slot] = CONTROL_DELETED;
+    table->oldCount--;
+  }
+  table->count--;
+
+  // give memory back after mass deletion. shrinking rehashes at most
+  // TABLE_MIN_LOAD of the slots, so it is never done incrementally
+  if (!isResizing(table) && table->capacity > TABLE_MIN_CAPACITY &&
+      table->count < table->capacity * TABLE_MIN_LOAD) {
+    adjustCapacity(table, capacityFor(table->count));
+  }
 
-  entry->key = NULL;
-  // set tombstone value
-  entry->value = BOOL_VAL(true);
   return true;
 }
 
@@ -101,20 +398,28 @@ bool tableDelete(Table* table, ObjString* key) {
 bool tableGet(Table* table, ObjString* key, Value* value) {
   if (table->count == 0) return false;
 
-  Entry* entry = findEntry(table->entries, table->capacity, key);
-  bool isEntryFound = entry->key != NULL;
+  uint32_t hash = stringHash(key);
+  migrateStep(table);
 
-  if (isEntryFound) {
-    *value = entry->value;
-  }
+  bool isOld;
+  int slot = findEntry(table, key, hash, &isOld);
+  if (slot == -1) return false;
 
-  return isEntryFound;
+  *value = isOld ? table->oldEntries[slot].value : table->entries[slot].value;
+  return true;
 }
 
 void tableAddAll(Table* fromTable, Table* toTable) {
   for (int i = 0; i < fromTable->capacity; i++) {
-    Entry* entry = &fromTable->entries[i];
-    if (entry->key != NULL) {
+    if (isFull(fromTable->control[i])) {
+      Entry* entry = &fromTable->entries[i];
+      tableSet(toTable, entry->key, entry->value);
+    }
+  }
+
+  for (int i = 0; i < fromTable->oldCapacity; i++) {
+    if (isFull(fromTable->oldControl[i])) {
+      Entry* entry = &fromTable->oldEntries[i];
       tableSet(toTable, entry->key, entry->value);
     }
   }
@@ -124,18 +429,68 @@ ObjString* tableFindString(Table* table, const char* chars, int length,
                            uint32_t hash) {
   if (table->count == 0) return NULL;
 
-  uint32_t index = hash % table->capacity;
+  migrateStep(table);
 
-  for (;;) {
-    Entry* entry = &table->entries[index];
+  int groups = 0;
+  ObjString* string =
+      findString(table->control, table->entries, table->capacity, chars,
+                 length, hash, &groups);
+  if (string == NULL) {
+    string = findString(table->oldControl, table->oldEntries,
+                        table->oldCapacity, chars, length, hash, &groups);
+  }
+  recordProbeLength(table->metrics, groups);
+  return string;
+}
 
-    if (entry->key == NULL && IS_NIL(entry->value)) {
-      return NULL;
-    } else if (entry->key->length == length && entry->key->hash == hash &&
-               memcmp(entry->key->chars, chars, length) == 0) {
-      return entry->key;
+Entry* tableNextEntry(Table* table, int* cursor) {
+  // the new slots come first, then the old ones mid-resize
+  for (; *cursor < table->capacity + table->oldCapacity; (*cursor)++) {
+    int i = *cursor;
+    if (i < table->capacity) {
+      if (isFull(table->control[i])) return &table->entries[(*cursor)++];
+    } else {
+      i -= table->capacity;
+      if (isFull(table->oldControl[i])) return &table->oldEntries[(*cursor)++];
     }
+  }
+
+  return NULL;
+}
+
+void markTable(Table* table) {
+  for (int i = 0; i < table->capacity; i++) {
+    if (!isFull(table->control[i])) continue;
+    markObject((Obj*)table->entries[i].key);
+    markValue(table->entries[i].value);
+  }
+
+  for (int i = 0; i < table->oldCapacity; i++) {
+    if (!isFull(table->oldControl[i])) continue;
+    markObject((Obj*)table->oldEntries[i].key);
+    markValue(table->oldEntries[i].value);
+  }
+}
+
+// runs in the middle of a collection, possibly under a tableSet on the
+// same table, so it only flips control bytes: no resizing or migration
+void tableRemoveWhite(Table* table) {
+  for (int i = 0; i < table->capacity; i++) {
+    if (!isFull(table->control[i])) continue;
+    if (table->entries[i].key->obj.isMarked) continue;
+
+    table->control[i] = CONTROL_DELETED;
+    table->entries[i].key = NULL;
+    table->tombstones++;
+    table->count--;
+  }
+
+  for (int i = 0; i < table->oldCapacity; i++) {
+    if (!isFull(table->oldControl[i])) continue;
+    if (table->oldEntries[i].key->obj.isMarked) continue;
 
-    index = (index + 1) % table->capacity;
+    table->oldControl[i] = CONTROL_DELETED;
+    table->oldCount--;
+    table->count--;
   }
 }
@@ -2,19 +2,55 @@
 #define clox_table_h
 
 #include "common.h"
+#include "metrics.h"
 #include "value.h"
 
+// max fraction of slots that may be live or deleted before a resize
 #define TABLE_MAX_LOAD 0.75
+// tables shrink once fewer than this fraction of slots are live
+#define TABLE_MIN_LOAD 0.125
+// slots are probed a group at a time, using SIMD where available
+#define TABLE_GROUP_WIDTH 16
+// incremental tables: old buckets migrated per table operation
+#define TABLE_MIGRATE_BUCKETS 64
+// incremental tables smaller than this still resize in one go
+#define TABLE_INCREMENTAL_MIN_COUNT 1024
 
 typedef struct {
   ObjString* key;
   Value value;
 } Entry;
 
+// open addressing table in the style of SwissTable: a separate array of
+// control bytes (one per slot) holds 7 bits of each key's hash, so probing
+// rarely needs to touch entries or keys.
+// keys are compared by identity, so they must be interned strings
 typedef struct {
+  // live entries
   int count;
+  // deleted slots, which still lengthen probe sequences until a rehash
+  int tombstones;
+  // 0 or a power of 2 that is a multiple of TABLE_GROUP_WIDTH
   int capacity;
+  uint8_t* control;
   Entry* entries;
+
+  // when set, resizes don't rehash in one pause. the old arrays are kept
+  // alongside the new ones and every operation migrates a few buckets
+  bool isIncremental;
+  // live entries still in the old arrays. included in count
+  int oldCount;
+  // 0 unless a resize is in progress
+  int oldCapacity;
+  // old buckets below this index have been migrated
+  int migrateIndex;
+  uint8_t* oldControl;
+  Entry* oldEntries;
+
+  // where lookups, probe lengths and resizes are counted. NULL counts
+  // nothing. like isIncremental, set after initTable() and kept by
+  // freeTable()
+  Metrics* metrics;
 } Table;
 
 void initTable(Table* table);
@@ -23,8 +59,17 @@ bool tableSet(Table* table, ObjString* key, Value value);
 bool tableDelete(Table* table, ObjString* key);
 bool tableGet(Table* table, ObjString* key, Value* value);
 void tableAddAll(Table* fromTable, Table* toTable);
+// iterates live entries, starting from *cursor = 0. returns NULL at the
+// end. the table must not be modified in between
+Entry* tableNextEntry(Table* table, int* cursor);
+// heap bytes held by the slot arrays, old ones included mid-resize
+size_t tableBytes(Table* table);
 
 ObjString* tableFindString(Table* table, const char* chars, int length,
                            uint32_t hash);
+// GC support
+void markTable(Table* table);
+// deletes every entry whose key is about to be swept
+void tableRemoveWhite(Table* table);
 
 #endif
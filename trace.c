@@ -0,0 +1,39 @@
+#include "trace.h"
+
+#include "debug.h"
+#include "output.h"
+
+TraceRing traceRing;
+
+void resetTrace() { traceRing.count = 0; }
+
+void traceInstruction(Chunk* chunk, int offset, Value* stack,
+                      Value* stackTop) {
+  writeOutputString("          ");
+  for (Value* slot = stack; slot < stackTop; slot++) {
+    writeOutput("[", 1);
+    printValue(*slot);
+    writeOutput("]", 1);
+  }
+  writeOutput("\n", 1);
+
+  disassembleInstruction(chunk, offset);
+}
+
+void dumpTrace(FILE* out, Chunk* chunk) {
+  if (traceRing.count == 0) return;
+
+  size_t first = traceRing.count > TRACE_RING_SIZE
+                     ? traceRing.count - TRACE_RING_SIZE
+                     : 0;
+  fprintf(out, "last %zu of %zu instructions:\n", traceRing.count - first,
+          traceRing.count);
+
+  for (size_t i = first; i < traceRing.count; i++) {
+    TraceRecord* record = &traceRing.records[i & (TRACE_RING_SIZE - 1)];
+    const char* name = opcodeName(chunk->code[record->offset]);
+    fprintf(out, "  %04d [line %d] %-16s stack %d\n", record->offset,
+            chunk->lines[record->offset], name != NULL ? name : "?",
+            record->stackDepth);
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef clox_trace_h
+#define clox_trace_h
+
+#include <stdio.h>
+
+#include "chunk.h"
+#include "common.h"
+
+// execution tracing. run() is compiled twice, with and without the tracing
+// hook, and interpret() picks one per call: with tracing off the dispatch
+// loop has no trace code in it at all.
+
+// executed instructions kept for the post-mortem dump. must be a power of 2
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 64
+#endif
+
+typedef enum {
+  TRACE_OFF,
+  // record into the ring buffer, dumped by runtimeError()
+  TRACE_RING,
+  // also print the stack and each instruction as it runs
+  TRACE_VERBOSE,
+} TraceMode;
+
+typedef struct {
+  // offset into the chunk being run. the opcode is read back from it
+  int offset;
+  int stackDepth;
+} TraceRecord;
+
+typedef struct {
+  TraceRecord records[TRACE_RING_SIZE];
+  // total recorded. the newest record is at (count - 1) % TRACE_RING_SIZE
+  size_t count;
+} TraceRing;
+
+extern TraceRing traceRing;
+
+static inline void traceRecord(int offset, int stackDepth) {
+  TraceRecord* record = &traceRing.records[traceRing.count++ &
+                                           (TRACE_RING_SIZE - 1)];
+  record->offset = offset;
+  record->stackDepth = stackDepth;
+}
+
+// forgets the records of the previous chunk
+void resetTrace();
+// prints the stack and disassembles the instruction at offset to
+// vm.output, in order with what the program prints
+void traceInstruction(Chunk* chunk, int offset, Value* stack,
+                      Value* stackTop);
+// oldest record first. chunk must be the one the records were taken from
+void dumpTrace(FILE* out, Chunk* chunk);
+
+#endif
@@ -1,23 +1,26 @@
 #include "value.h"
 
-#include <stdio.h>
 #include <string.h>
 
+#include "arena.h"
 #include "memory.h"
+#include "number.h"
 #include "object.h"
+#include "output.h"
 
 void initValueArray(ValueArray *array) {
   array->count = 0;
   array->capacity = 0;
   array->values = NULL;
+  array->arena = NULL;
 }
 
 void writeValueArray(ValueArray *array, Value value) {
   if (array->capacity < array->count + 1) {
     int oldCapacity = array->capacity;
     array->capacity = GROW_CAPACITY(oldCapacity);
-    array->values =
-        GROW_ARRAY(Value, array->values, oldCapacity, array->capacity);
+    array->values = ARENA_GROW_ARRAY(array->arena, Value, array->values,
+                                     oldCapacity, array->capacity);
   }
 
   array->values[array->count] = value;
@@ -25,21 +28,24 @@ void writeValueArray(ValueArray *array, Value value) {
 }
 
 void freeValueArray(ValueArray *array) {
-  FREE_ARRAY(Value, array->values, array->capacity);
+  ARENA_FREE_ARRAY(array->arena, Value, array->values, array->capacity);
   initValueArray(array);
 }
 
 void printValue(Value value) {
   switch (value.type) {
     case VAL_BOOL:
-      printf(AS_BOOL(value) ? "true" : "false");
+      writeOutputString(AS_BOOL(value) ? "true" : "false");
       break;
     case VAL_NIL:
-      printf("nil");
+      writeOutput("nil", 3);
       break;
-    case VAL_NUMBER:
-      printf("%g", AS_NUMBER(value));
+    case VAL_NUMBER: {
+      char buffer[NUMBER_FORMAT_MAX];
+      int length = formatNumber(AS_NUMBER(value), buffer);
+      writeOutput(buffer, (size_t)length);
       break;
+    }
     case VAL_OBJ:
       printObject(value);
       break;
@@ -57,11 +63,21 @@ bool areValuesEqual(Value a, Value b) {
     case VAL_NUMBER:
       return AS_NUMBER(a) == AS_NUMBER(b);
     case VAL_OBJ: {
-      return AS_STRING(a) == AS_STRING(b);
-      // ObjString *stringA = AS_STRING(a);
-      // ObjString *stringB = AS_STRING(b);
-      // return stringA->length == stringB->length &&
-      //        memcmp(stringA->chars, stringB->chars, stringA->length) == 0;
+      if (AS_OBJ(a) == AS_OBJ(b)) return true;
+      if (!IS_STRING(a) || !IS_STRING(b)) return false;
+
+      ObjString *stringA = AS_STRING(a);
+      ObjString *stringB = AS_STRING(b);
+      // interned strings are unique, so different objects differ
+      if (stringA->isInterned && stringB->isInterned) return false;
+      if (stringA->length != stringB->length) return false;
+      // only use hashes that are already known: computing one costs as
+      // much as the memcmp itself
+      if (stringA->isHashed && stringB->isHashed &&
+          stringA->hash != stringB->hash) {
+        return false;
+      }
+      return memcmp(stringA->chars, stringB->chars, stringA->length) == 0;
     }
     default:
       return false;
@@ -34,10 +34,14 @@ typedef struct {
 #define IS_NUMBER(value) ((value).type == VAL_NUMBER)
 #define IS_OBJ(value) ((value).type == VAL_OBJ)
 
+typedef struct Arena Arena;
+
 typedef struct {
   int count;
   int capacity;
   Value *values;
+  // owner of values, or NULL for the GC heap
+  Arena *arena;
 } ValueArray;
 
 void initValueArray(ValueArray *array);
@@ -1,15 +1,27 @@
+// profileClock() may use clock_gettime() (see profile.h)
+#define _POSIX_C_SOURCE 199309L
+
 #include "vm.h"
 
+#include <limits.h>
+#include <math.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
+#include "arena.h"
 #include "chunk.h"
 #include "compiler.h"
-#include "debug.h"
+#include "heap.h"
 #include "memory.h"
 #include "object.h"
+#include "output.h"
+#include "pool.h"
+#include "profile.h"
+#include "sampler.h"
 #include "table.h"
+#include "trace.h"
 
 VM vm;
 
@@ -21,39 +33,155 @@ static bool isFalsey(Value value) {
   return IS_NIL(value) || (IS_BOOL(value) && !AS_BOOL(value));
 }
 
-static void concatenate() {
-  ObjString* stringB = AS_STRING(pop());
-  ObjString* stringA = AS_STRING(pop());
-
-  // copy A then B into a newly allocated piece of memory
-  int totalLength = stringA->length + stringB->length;
-  char* chars = ALLOCATE(char, totalLength + 1);
-  memcpy(chars, stringA->chars, stringA->length);
-  memcpy(chars + stringA->length, stringB->chars, stringB->length);
-  chars[totalLength] = '\0';
-
-  ObjString* newStringObj = takeString(chars, totalLength);
-  push(OBJ_VAL(newStringObj));
+static ObjString* concatenate(ObjString* stringA, ObjString* stringB) {
+  // copy A then B straight into the result's inline chars
+  ObjString* result = allocateString(stringA->length + stringB->length);
+  memcpy(result->chars, stringA->chars, stringA->length);
+  memcpy(result->chars + stringA->length, stringB->chars, stringB->length);
+  return result;
 }
 
 static void runtimeError(const char* format, ...) {
+  flushOutputBeforeError();
+
   va_list args;
   va_start(args, format);
   vfprintf(stderr, format, args);
   va_end(args);
   fputs("\n", stderr);
 
+  // no instruction to blame while compiling
+  if (vm.ip == NULL) {
+    resetStack();
+    return;
+  }
+
   // note: VM consumes the token before it throws a
   // runtime error, hence the "-1" to get the prev inst
   size_t instruction = vm.ip - vm.chunk->code - 1;
   int line = vm.chunk->lines[instruction];
   fprintf(stderr, "[line %d] in script\n", line);
 
+  if (vm.traceMode != TRACE_OFF) dumpTrace(stderr, vm.chunk);
+
   resetStack();
 }
 
-static InterpretResult run() {
+// ObjString.length is an int, so longer results are a runtime error
+static bool checkStringLength(size_t length) {
+  if (length <= INT_MAX) return true;
+  runtimeError("String is too long.");
+  return false;
+}
+
+// same semantics as OP_ADD: 2 numbers or 2 strings
+static bool addValues(Value left, Value right, Value* result) {
+  if (IS_STRING(left) && IS_STRING(right)) {
+    ObjString* stringA = AS_STRING(left);
+    ObjString* stringB = AS_STRING(right);
+    if (!checkStringLength((size_t)stringA->length + stringB->length)) {
+      return false;
+    }
+    *result = OBJ_VAL(concatenate(stringA, stringB));
+  } else if (IS_NUMBER(left) && IS_NUMBER(right)) {
+    *result = NUMBER_VAL(AS_NUMBER(left) + AS_NUMBER(right));
+  } else {
+    runtimeError("Operands must be 2 numbers or 2 strings.");
+    return false;
+  }
+
+  return true;
+}
+
+// adds the top count values of the stack, left to right
+static bool addN(int count) {
+  Value* operands = vm.stackTop - count;
+
+  bool areAllStrings = true;
+  // summed in a size_t: N int lengths can overflow an int
+  size_t totalLength = 0;
+  for (int i = 0; i < count; i++) {
+    if (!IS_STRING(operands[i])) {
+      areAllStrings = false;
+      break;
+    }
+    totalLength += AS_STRING(operands[i])->length;
+  }
+
+  if (areAllStrings) {
+    if (!checkStringLength(totalLength)) return false;
+    // size the result once and copy each part exactly once, so only the
+    // final string is allocated
+    ObjString* result = allocateString((int)totalLength);
+    char* dest = result->chars;
+    for (int i = 0; i < count; i++) {
+      ObjString* part = AS_STRING(operands[i]);
+      memcpy(dest, part->chars, part->length);
+      dest += part->length;
+    }
+
+    operands[0] = OBJ_VAL(result);
+  } else {
+    // fold left like a chain of OP_ADDs, so mixed operands behave the same
+    for (int i = 1; i < count; i++) {
+      if (!addValues(operands[0], operands[i], &operands[0])) return false;
+    }
+  }
+
+  // the result is left in the 1st operand's slot
+  vm.stackTop -= count - 1;
+  return true;
+}
+
+static bool callNative(ObjNative* native, int argCount) {
+  if (argCount != native->arity) {
+    runtimeError("Expected %d arguments but got %d.", native->arity, argCount);
+    return false;
+  }
+
+  // args are passed in place: they are the top argCount slots of the stack
+  Value* args = vm.stackTop - argCount;
+  Value result;
+
+  if (native->numericFunction != NULL) {
+    if (!IS_NUMBER(args[0])) {
+      runtimeError("Argument to '%.*s' must be a number.",
+                   native->name->length, native->name->chars);
+      return false;
+    }
+    result = NUMBER_VAL(native->numericFunction(AS_NUMBER(args[0])));
+  } else {
+    result = native->function(argCount, args);
+  }
+
+  // discard the args and the callee itself
+  vm.stackTop -= argCount + 1;
+  push(result);
+  return true;
+}
+
+static bool callValue(Value callee, int argCount) {
+  if (IS_NATIVE(callee)) {
+    return callNative(AS_NATIVE(callee), argCount);
+  }
+
+  runtimeError("Can only call functions.");
+  return false;
+}
+
+// isTracing and isSampled are constants in each of the instantiations
+// below, so the plain loop is compiled without any trace or sampler code.
+// instructions are counted in the caller's local, which stays in a
+// register, and only added to METRIC_INSTRUCTIONS before calls that may
+// allocate: a failed allocation unwinds straight to interpret()
+static inline __attribute__((always_inline)) InterpretResult
+runLoop(bool isTracing, bool isSampled, uint64_t* instructions) {
 #define READ_BYTE() (*vm.ip++)
+#define FLUSH_INSTRUCTIONS()                          \
+  do {                                                \
+    METRIC_ADD(METRIC_INSTRUCTIONS, *instructions);   \
+    *instructions = 0;                                \
+  } while (false)
 #define READ_CONSTANT() (vm.chunk->constants.values[READ_BYTE()])
 #define BINARY_OP(valueType, op)                      \
   do {                                                \
@@ -67,25 +195,24 @@ static InterpretResult run() {
   } while (false)
 
   for (;;) {
-#ifdef DEBUG_TRACE_EXECUTION
-    printf("          ");
-    for (Value* slot = vm.stack; slot < vm.stackTop; slot++) {
-      printf("[");
-      printValue(*slot);
-      printf("]");
+    if (isSampled) publishSampledIp(vm.ip);
+    if (isTracing) {
+      int offset = (int)(vm.ip - vm.chunk->code);
+      traceRecord(offset, (int)(vm.stackTop - vm.stack));
+      if (vm.traceMode == TRACE_VERBOSE) {
+        traceInstruction(vm.chunk, offset, vm.stack, vm.stackTop);
+      }
     }
-    printf("\n");
-
-    disassembleInstruction(vm.chunk, (int)(vm.ip - vm.chunk->code));
-#endif
 
     uint8_t instruction = READ_BYTE();
+    (*instructions)++;
+#ifdef PROFILE_OPCODES
+    profileInstruction(instruction);
+#endif
     switch (instruction) {
       case OP_CONSTANT: {
         Value constant = READ_CONSTANT();
         push(constant);
-        printValue(constant);
-        printf("\n");
         break;
       }
       case OP_NIL:
@@ -124,7 +251,16 @@ static InterpretResult run() {
 
       case OP_ADD:
         if (IS_STRING(peek(0)) && IS_STRING(peek(1))) {
-          concatenate();
+          FLUSH_INSTRUCTIONS();
+          ObjString* stringB = AS_STRING(peek(0));
+          ObjString* stringA = AS_STRING(peek(1));
+          if (!checkStringLength((size_t)stringA->length + stringB->length)) {
+            return INTERPRET_RUNTIME_ERROR;
+          }
+          ObjString* result = concatenate(stringA, stringB);
+          pop();
+          pop();
+          push(OBJ_VAL(result));
         } else if (IS_NUMBER(peek(0)) && IS_NUMBER(peek(1))) {
           double right = AS_NUMBER(pop());
           double left = AS_NUMBER(pop());
@@ -135,6 +271,11 @@ static InterpretResult run() {
         }
         break;
 
+      case OP_CONCAT_N:
+        FLUSH_INSTRUCTIONS();
+        if (!addN(READ_BYTE())) return INTERPRET_RUNTIME_ERROR;
+        break;
+
       case OP_SUBTRACT:
         BINARY_OP(NUMBER_VAL, -);
         break;
@@ -147,45 +288,219 @@ static InterpretResult run() {
         BINARY_OP(NUMBER_VAL, /);
         break;
 
+      case OP_CALL: {
+        int argCount = READ_BYTE();
+        FLUSH_INSTRUCTIONS();
+        if (!callValue(peek(argCount), argCount)) {
+          return INTERPRET_RUNTIME_ERROR;
+        }
+        break;
+      }
+
       case OP_RETURN: {
         printValue(pop());
-        printf("\n");
+        writeOutput("\n", 1);
         return INTERPRET_OK;
       }
     }
   }
 
 #undef READ_BYTE
+#undef FLUSH_INSTRUCTIONS
 #undef READ_CONSTANT
 #undef BINARY_OP
 }
 
-void initVM() {
+static InterpretResult run() {
+  uint64_t instructions = 0;
+  InterpretResult result = runLoop(false, false, &instructions);
+  METRIC_ADD(METRIC_INSTRUCTIONS, instructions);
+  return result;
+}
+
+static InterpretResult runSampled() {
+  uint64_t instructions = 0;
+  InterpretResult result = runLoop(false, true, &instructions);
+  METRIC_ADD(METRIC_INSTRUCTIONS, instructions);
+  return result;
+}
+
+// tracing is slow enough that publishing the ip too makes no difference
+static InterpretResult runTraced() {
+  uint64_t instructions = 0;
+  InterpretResult result = runLoop(true, true, &instructions);
+  METRIC_ADD(METRIC_INSTRUCTIONS, instructions);
+  return result;
+}
+
+//---------- START NATIVES ------------//
+static Value clockNative(int argCount, Value* args) {
+  (void)argCount;
+  (void)args;
+  return NUMBER_VAL((double)clock() / CLOCKS_PER_SEC);
+}
+
+static void defineBuiltins() {
+  defineNative("clock", clockNative, 0);
+  defineNumericNative("sqrt", sqrt);
+  defineNumericNative("floor", floor);
+  defineNumericNative("ceil", ceil);
+  defineNumericNative("abs", fabs);
+}
+
+// both objects stay on the stack until they are reachable from vm.natives
+static void registerNative(ObjNative* native) {
+  push(OBJ_VAL(native));
+  tableSet(&vm.natives, native->name, OBJ_VAL(native));
+  pop();
+  pop();
+}
+
+void defineNative(const char* name, NativeFn function, int arity) {
+  push(OBJ_VAL(internString(name, (int)strlen(name))));
+  registerNative(newNative(AS_STRING(peek(0)), function, arity));
+}
+
+void defineNumericNative(const char* name, NumericNativeFn function) {
+  push(OBJ_VAL(internString(name, (int)strlen(name))));
+  registerNative(newNumericNative(AS_STRING(peek(0)), function));
+}
+//---------- END NATIVES ------------//
+
+void initVM() { initVMWithAllocator(defaultAllocator()); }
+
+void initVMWithAllocator(Allocator allocator) {
   resetStack();
+  vm.chunk = NULL;
+  vm.ip = NULL;
   vm.objects = NULL;
+  vm.allocator = allocator;
+  vm.bytesAllocated = 0;
+  vm.peakBytesAllocated = 0;
+  vm.memoryLimit = 0;
+  vm.memoryErrorJump = NULL;
+#ifdef DEBUG_TRACE_EXECUTION
+  vm.traceMode = TRACE_VERBOSE;
+#else
+  vm.traceMode = TRACE_OFF;
+#endif
+#ifdef PROFILE_OPCODES
+  initOpcodeProfile();
+#endif
+  initMetrics(&vm.metrics);
+  initOutput(&vm.output);
+  vm.nextGC = GC_INITIAL_THRESHOLD;
+  vm.grayCount = 0;
+  vm.grayCapacity = 0;
+  vm.grayStack = NULL;
+  vm.internMaxLength = INTERN_MAX_LENGTH;
+  vm.lexThreadMinLength = 0;
   initTable(&vm.strings);
+  // the intern table grows with the program, so spread its resizes out
+  vm.strings.isIncremental = true;
+  vm.strings.metrics = &vm.metrics;
+  initTable(&vm.natives);
+  vm.natives.metrics = &vm.metrics;
+
+  defineBuiltins();
 }
 
 void freeVM() {
+  freeOutput(&vm.output);
   freeObjects();
   freeTable(&vm.strings);
+  freeTable(&vm.natives);
+#ifdef USE_POOL_ALLOCATOR
+  freePools();
+#endif
 }
 
-InterpretResult interpret(const char* source) {
-  Chunk chunk;
-  initChunk(&chunk);
+// charges the time since the previous phase ended to metric
+static void endPhase(Metric metric) {
+  uint64_t now = metricsNow();
+  METRIC_ADD(metric, now - vm.metrics.phaseStart);
+  vm.metrics.phaseStart = now;
+}
 
-  if (!compile(source, &chunk)) {
-    freeChunk(&chunk);
-    return INTERPRET_COMPILE_ERROR;
+// splits compile time between scanning and the rest
+static void endCompilePhase() {
+  uint64_t now = metricsNow();
+  uint64_t compileNs = now - vm.metrics.phaseStart;
+  // an estimate, so it can overshoot on tiny sources
+  uint64_t scanNs = vm.metrics.scanNs;
+  if (scanNs > compileNs) scanNs = compileNs;
+
+  METRIC_ADD(METRIC_SCAN_NS, scanNs);
+  METRIC_ADD(METRIC_COMPILE_NS, compileNs - scanNs);
+  vm.metrics.phaseStart = now;
+}
+
+// the setjmp is here and not in interpret(), which owns the arena and chunk:
+// compile() and run() change both, and C11 7.13.2.1 leaves such locals of
+// the function that called setjmp indeterminate after a longjmp
+static InterpretResult compileAndRun(const char* source, Chunk* chunk) {
+  InterpretResult result = INTERPRET_COMPILE_ERROR;
+  // allocation failures in compile() or run() land here instead of exiting
+  jmp_buf memoryErrorJump;
+  jmp_buf* enclosingJump = vm.memoryErrorJump;
+  if (setjmp(memoryErrorJump) == 0) {
+    vm.memoryErrorJump = &memoryErrorJump;
+    bool isCompiled = compile(source, chunk);
+    endCompilePhase();
+    if (isCompiled) {
+      vm.ip = chunk->code;
+      bool isSampled = beginSampledRun(chunk);
+      if (vm.traceMode != TRACE_OFF) {
+        result = runTraced();
+      } else {
+        result = isSampled ? runSampled() : run();
+      }
+    }
+  } else {
+    abortCompile();
+    if (vm.memoryLimit != 0) {
+      runtimeError("Out of memory (limit is %zu bytes).", vm.memoryLimit);
+    } else {
+      runtimeError("Out of memory.");
+    }
+    result = INTERPRET_RUNTIME_ERROR;
   }
+  vm.memoryErrorJump = enclosingJump;
+  return result;
+}
 
-  vm.chunk = &chunk;
-  vm.ip = vm.chunk->code;
+InterpretResult interpret(const char* source) {
+  METRIC_INC(METRIC_INTERPRET_CALLS);
+  vm.metrics.phaseStart = metricsNow();
+  vm.metrics.scanNs = 0;
 
-  InterpretResult result = run();
+  // all of the chunk's arrays are released in one go at the end
+  Arena arena;
+  initArena(&arena);
+  Chunk chunk;
+  initChunkInArena(&chunk, &arena);
+  // rooted from here on, including while freeChunk releases literals
+  vm.chunk = &chunk;
+  vm.ip = NULL;
+  resetTrace();
+
+  InterpretResult result = compileAndRun(source, &chunk);
+  // also reached when run() was unwound
+  endSampledRun(&chunk);
+#ifdef PROFILE_OPCODES
+  profileEnd();
+#endif
+  // an unwound compile is charged here too
+  endPhase(METRIC_RUN_NS);
 
+  // --heap-stats is printed after the chunk is gone
+  recordChunkStats(&chunk);
+  // releases borrowed literals, which are heap objects, not arena memory
   freeChunk(&chunk);
+  freeArena(&arena);
+  vm.chunk = NULL;
+  endPhase(METRIC_FREE_NS);
+  flushOutput();
   return result;
 }
 
@@ -1,19 +1,60 @@
 #ifndef clox_vm_h
 #define clox_vm_h
 
+#include <setjmp.h>
+
 #include "chunk.h"
+#include "memory.h"
+#include "metrics.h"
+#include "object.h"
+#include "output.h"
 #include "table.h"
+#include "trace.h"
 #include "value.h"
 
 #define STACK_MAX 256
+// default cutoff above which copied strings skip the intern table
+#define INTERN_MAX_LENGTH 64
+// smallest source --lex-thread scans on its own thread unless given one
+#define LEX_THREAD_MIN_LENGTH (64 * 1024)
 
 typedef struct {
+  // chunk being compiled or run. its constants are GC roots
   Chunk *chunk;
   uint8_t *ip;
   Value stack[STACK_MAX];
   Value *stackTop;
   Table strings;
+  // strings longer than this are not interned by copyString or
+  // borrowString. INTERN_MAX_LENGTH unless set with --intern-max (or by
+  // an embedder, between interpret() calls)
+  int internMaxLength;
+  // sources at least this long are scanned on a producer thread while
+  // compiling (see lexer.h). 0 scans every source inline
+  size_t lexThreadMinLength;
+  // host functions callable from Lox, keyed by interned name
+  Table natives;
   Obj *objects;
+
+  Allocator allocator;
+  // live and high-water heap bytes, both maintained by reallocate()
+  size_t bytesAllocated;
+  size_t peakBytesAllocated;
+  // 0 means no limit. going past it is a runtime error, not an exit
+  size_t memoryLimit;
+  // armed by interpret() for the duration of compile and run
+  jmp_buf *memoryErrorJump;
+  // read by interpret() once per call
+  TraceMode traceMode;
+  Metrics metrics;
+  // where printed values go (see output.h)
+  Output output;
+
+  // GC state
+  size_t nextGC;
+  int grayCount;
+  int grayCapacity;
+  Obj **grayStack;
 } VM;
 
 typedef enum {
@@ -25,9 +66,14 @@ typedef enum {
 extern VM vm;
 
 void initVM();
+void initVMWithAllocator(Allocator allocator);
 void freeVM();
 InterpretResult interpret(const char *source);
 void push(Value value);
 Value pop();
 
+// C API for exposing host functions to Lox code
+void defineNative(const char *name, NativeFn function, int arity);
+void defineNumericNative(const char *name, NumericNativeFn function);
+
 #endif